@@ -73,16 +73,24 @@ doDirectConnect() {
 
 #ifndef PION_SKIP_PAKE
 static bool
-initPake() {
-  device.reset(new pion::pake::Device(pion::pake::Device::Options{
-    face: *face,
-  }));
+beginPake() {
   if (!device->begin(getPassword())) {
     PION_LOG_ERR("device.begin error");
     return false;
   }
   return true;
 }
+
+static bool
+initPake() {
+  // the Device is kept across attempts, so that its PAKE request limiter spans them
+  device.reset(new pion::pake::Device(pion::pake::Device::Options{
+    face: *face,
+    pakeBurst: 3,
+    pakeIntervalMs: 30000,
+  }));
+  return beginPake();
+}
 #endif // PION_SKIP_PAKE
 
 void
@@ -104,7 +112,9 @@ waitPake() {
     }
     case pion::pake::Device::State::Failure: {
       PION_LOG_ERR("pake-device failure");
-      state = State::Failure;
+      if (!beginPake()) {
+        state = State::Failure;
+      }
       break;
     }
     default: {
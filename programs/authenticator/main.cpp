@@ -7,11 +7,12 @@ static std::string authenticatorKeySlot;
 static ndnph::Name deviceName;
 static ndnph::tlv::Value pakePassword;
 static ndnph::tlv::Value networkCredential;
+static bool compressPoints = false;
 
 static bool
 parseArgs(int argc, char** argv) {
   int c;
-  while ((c = getopt(argc, argv, "P:i:n:p:N:")) != -1) {
+  while ((c = getopt(argc, argv, "P:i:n:p:N:c")) != -1) {
     switch (c) {
       case 'P': {
         profileFilename = optarg;
@@ -33,6 +34,10 @@ parseArgs(int argc, char** argv) {
         networkCredential = ndnph::tlv::Value::fromString(optarg);
         break;
       }
+      case 'c': {
+        compressPoints = true;
+        break;
+      }
     }
   }
 
@@ -44,7 +49,8 @@ int
 main(int argc, char** argv) {
   if (!parseArgs(argc, argv)) {
     fprintf(stderr,
-            "%s -P CA-PROFILE-FILE -i AK-SLOT -n DEVICE-NAME -p PASSWORD -N NETWORK-CREDENTIAL\n",
+            "%s -P CA-PROFILE-FILE -i AK-SLOT -n DEVICE-NAME -p PASSWORD -N NETWORK-CREDENTIAL"
+            " [-c]\n",
             argv[0]);
     return 1;
   }
@@ -73,6 +79,7 @@ main(int argc, char** argv) {
     signer: signer,
     nc: networkCredential,
     deviceName: deviceName,
+    compressPoints: compressPoints,
   });
   if (!authenticator.begin(pakePassword)) {
     fprintf(stderr, "authenticator.begin error\n");
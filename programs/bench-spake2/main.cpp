@@ -0,0 +1,299 @@
+#include "pion/spake2/spake2.hpp"
+
+#include <mbedtls/platform.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+/** @brief Allocations by mbedtls. */
+struct HeapStats {
+  size_t nAllocs = 0;
+  size_t live = 0;
+  size_t peak = 0;
+};
+
+HeapStats heap;
+
+#if (defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)) ||             \
+  defined(__GLIBC__)
+// sizes of live allocations; allocations made before counting starts, such as those of static
+// objects, are absent and are not counted when they are freed
+std::unordered_map<void*, size_t>* allocSizes = nullptr;
+
+void
+countAlloc(void* p, size_t total) {
+  (*allocSizes)[p] = total;
+  ++heap.nAllocs;
+  heap.live += total;
+  heap.peak = std::max(heap.peak, heap.live);
+}
+
+void
+countFree(void* p) {
+  auto it = allocSizes->find(p);
+  if (it != allocSizes->end()) {
+    heap.live -= it->second;
+    allocSizes->erase(it);
+  }
+}
+#endif
+
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+void*
+countingCalloc(size_t n, size_t size) {
+  void* p = std::calloc(n, size);
+  if (p != nullptr) {
+    countAlloc(p, n * size);
+  }
+  return p;
+}
+
+void
+countingFree(void* p) {
+  countFree(p);
+  std::free(p);
+}
+
+bool
+installHeapHooks() {
+  allocSizes = new std::unordered_map<void*, size_t>();
+  return mbedtls_platform_set_calloc_free(countingCalloc, countingFree) == 0;
+}
+#elif defined(__GLIBC__)
+// mbedtls without MBEDTLS_PLATFORM_MEMORY, such as a distro libmbedcrypto, calls calloc() and
+// free() directly. They are interposed here, which also reaches calls from within a shared
+// libmbedcrypto, and forwarded to glibc's allocator. The bench allocates nothing else with
+// calloc(), so the counts still reflect mbedtls.
+} // namespace
+
+extern "C" {
+void*
+__libc_calloc(size_t n, size_t size);
+void
+__libc_free(void* p);
+}
+
+namespace {
+
+// set while counting, to let through the allocations of allocSizes itself
+thread_local bool inHook = false;
+
+} // namespace
+
+extern "C" void*
+calloc(size_t n, size_t size) noexcept {
+  void* p = __libc_calloc(n, size);
+  if (p != nullptr && allocSizes != nullptr && !inHook) {
+    inHook = true;
+    countAlloc(p, n * size);
+    inHook = false;
+  }
+  return p;
+}
+
+extern "C" void
+free(void* p) noexcept {
+  if (p != nullptr && allocSizes != nullptr && !inHook) {
+    inHook = true;
+    countFree(p);
+    inHook = false;
+  }
+  __libc_free(p);
+}
+
+namespace {
+
+bool
+installHeapHooks() {
+  allocSizes = new std::unordered_map<void*, size_t>();
+  return true;
+}
+#else
+bool
+installHeapHooks() {
+  return false;
+}
+#endif
+
+bool hasHeapStats = false;
+
+enum Step {
+  Start,
+  GenerateFirstMessage,
+  ProcessFirstMessage,
+  GenerateSecondMessage,
+  ProcessSecondMessage,
+  NSteps,
+};
+
+const char* const stepNames[NSteps] = {
+  "start",
+  "generateFirstMessage",
+  "processFirstMessage",
+  "generateSecondMessage",
+  "processSecondMessage",
+};
+
+const char* const roleNames[2] = {"Alice", "Bob"};
+
+struct Sample {
+  uint64_t ns;
+  size_t nAllocs;
+  size_t peakHeap; // above the heap usage before the step
+};
+
+/** @brief Run one step and record its duration and allocations. */
+template<typename F>
+bool
+measure(std::vector<Sample>* samples, const F& f) {
+  heap.nAllocs = 0;
+  heap.peak = heap.live;
+  size_t before = heap.live;
+
+  auto t0 = std::chrono::steady_clock::now();
+  bool ok = f();
+  auto t1 = std::chrono::steady_clock::now();
+
+  if (samples != nullptr) {
+    samples->push_back(Sample{
+      static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()),
+      heap.nAllocs, heap.peak - before});
+  }
+  return ok;
+}
+
+/** @brief Print one NDJSON record per role and step. */
+void
+report(const char* group, const char* hash, std::vector<Sample> (&samples)[2][NSteps]) {
+  for (int role = 0; role < 2; ++role) {
+    for (int step = 0; step < NSteps; ++step) {
+      std::vector<Sample>& v = samples[role][step];
+      if (v.empty()) {
+        continue;
+      }
+      std::vector<uint64_t> ns;
+      size_t nAllocs = 0, peakHeap = 0;
+      for (const Sample& s : v) {
+        ns.push_back(s.ns);
+        nAllocs = std::max(nAllocs, s.nAllocs);
+        peakHeap = std::max(peakHeap, s.peakHeap);
+      }
+      std::sort(ns.begin(), ns.end());
+      size_t n = ns.size();
+      uint64_t median = ns[(n - 1) / 2];
+      uint64_t p99 = ns[std::min(n - 1, (n * 99 + 99) / 100 - 1)];
+
+      printf("{\"group\":\"%s\",\"hash\":\"%s\",\"role\":\"%s\",\"step\":\"%s\",\"n\":%zu,"
+             "\"median_ns\":%llu,\"p99_ns\":%llu,",
+             group, hash, roleNames[role], stepNames[step], n,
+             static_cast<unsigned long long>(median), static_cast<unsigned long long>(p99));
+      if (hasHeapStats) {
+        printf("\"allocs\":%zu,\"peak_heap\":%zu}\n", nAllocs, peakHeap);
+      } else {
+        printf("\"allocs\":null,\"peak_heap\":null}\n");
+      }
+    }
+  }
+}
+
+/**
+ * @brief Benchmark complete exchanges of one group and hash.
+ * @param nIterations number of measured exchanges, after one unmeasured warm-up exchange.
+ */
+template<typename Group, typename Hash>
+bool
+bench(const char* group, const char* hash, int nIterations) {
+  using namespace spake2;
+  Random& random = Random::forThisThread();
+  Context<Role::Alice, Group, Hash> a(random);
+  Context<Role::Bob, Group, Hash> b(random);
+
+  static const uint8_t pw[] = {'p', 'a', 's', 's', 'w', 'o', 'r', 'd'};
+  static const uint8_t idA[] = {'a', 'l', 'i', 'c', 'e'};
+  static const uint8_t idB[] = {'b', 'o', 'b'};
+  static const uint8_t aad[] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08};
+  uint8_t pA[Group::UncompressedPointSize], pB[Group::UncompressedPointSize];
+  uint8_t cA[Hash::OutputSize], cB[Hash::OutputSize];
+
+  std::vector<Sample> samples[2][NSteps];
+  for (int i = -1; i < nIterations; ++i) {
+    a.reset();
+    b.reset();
+    auto sA = [&](Step step) { return i < 0 ? nullptr : &samples[0][step]; };
+    auto sB = [&](Step step) { return i < 0 ? nullptr : &samples[1][step]; };
+
+    bool ok =
+      measure(sA(Start),
+              [&] { return a.start(pw, sizeof(pw), idA, sizeof(idA), idB, sizeof(idB), aad,
+                                   sizeof(aad)); }) &&
+      measure(sB(Start),
+              [&] { return b.start(pw, sizeof(pw), idB, sizeof(idB), idA, sizeof(idA), aad,
+                                   sizeof(aad)); }) &&
+      measure(sA(GenerateFirstMessage), [&] { return a.generateFirstMessage(pA, sizeof(pA)); }) &&
+      measure(sB(GenerateFirstMessage), [&] { return b.generateFirstMessage(pB, sizeof(pB)); }) &&
+      measure(sA(ProcessFirstMessage), [&] { return a.processFirstMessage(pB, sizeof(pB)); }) &&
+      measure(sB(ProcessFirstMessage), [&] { return b.processFirstMessage(pA, sizeof(pA)); }) &&
+      measure(sA(GenerateSecondMessage), [&] { return a.generateSecondMessage(cA, sizeof(cA)); }) &&
+      measure(sB(GenerateSecondMessage), [&] { return b.generateSecondMessage(cB, sizeof(cB)); }) &&
+      measure(sA(ProcessSecondMessage), [&] { return a.processSecondMessage(cB, sizeof(cB)); }) &&
+      measure(sB(ProcessSecondMessage), [&] { return b.processSecondMessage(cA, sizeof(cA)); }) &&
+      a.getSharedKey() == b.getSharedKey();
+    if (!ok) {
+      fprintf(stderr, "%s-%s exchange failed\n", group, hash);
+      return false;
+    }
+  }
+
+  report(group, hash, samples);
+  return true;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv) {
+  int nIterations = 100;
+  bool wantHeapStats = true;
+  int c;
+  while ((c = getopt(argc, argv, "n:T")) != -1) {
+    switch (c) {
+      case 'n': {
+        nIterations = std::atoi(optarg);
+        break;
+      }
+      case 'T': {
+        wantHeapStats = false;
+        break;
+      }
+      default: {
+        nIterations = 0;
+        break;
+      }
+    }
+  }
+  if (argc - optind != 0 || nIterations <= 0) {
+    fprintf(stderr, "%s [-n ITERATIONS] [-T]\n", argv[0]);
+    return 1;
+  }
+  // counting allocations slows them down; -T measures time only
+  hasHeapStats = wantHeapStats && installHeapHooks();
+
+  using namespace spake2;
+  bool ok = bench<P256, SHA256>("P256", "SHA256", nIterations) &&
+            bench<P256, SHA512>("P256", "SHA512", nIterations) &&
+            bench<P384, SHA256>("P384", "SHA256", nIterations) &&
+            bench<P384, SHA512>("P384", "SHA512", nIterations) &&
+            bench<P521, SHA256>("P521", "SHA256", nIterations) &&
+            bench<P521, SHA512>("P521", "SHA512", nIterations) &&
+            bench<Edwards25519, SHA256>("Edwards25519", "SHA256", nIterations) &&
+            bench<Edwards25519, SHA512>("Edwards25519", "SHA512", nIterations);
+  return ok ? 0 : 1;
+}
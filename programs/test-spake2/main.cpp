@@ -0,0 +1,359 @@
+#include "pion/spake2/spake2.hpp"
+
+#include <mbedtls/md.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+int nFailures = 0;
+
+#define EXPECT(cond) expect((cond), #cond, __LINE__)
+
+void
+expect(bool ok, const char* expr, int line) {
+  if (!ok) {
+    fprintf(stderr, "line %d: %s\n", line, expr);
+    ++nFailures;
+  }
+}
+
+std::vector<uint8_t>
+fromHex(const char* hex) {
+  std::vector<uint8_t> v;
+  for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2) {
+    unsigned b = 0;
+    sscanf(hex, "%2x", &b);
+    v.push_back(static_cast<uint8_t>(b));
+  }
+  return v;
+}
+
+/** @brief Return the compressed SEC1 encoding of an uncompressed point. */
+std::vector<uint8_t>
+compress(const std::vector<uint8_t>& uncompressed) {
+  size_t half = (uncompressed.size() - 1) / 2;
+  std::vector<uint8_t> v(uncompressed.begin(), uncompressed.begin() + 1 + half);
+  v[0] = static_cast<uint8_t>(0x02 | (uncompressed.back() & 0x01));
+  return v;
+}
+
+bool
+sha512(const uint8_t* in, size_t len, uint8_t* digest) {
+  return mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA512), in, len, digest) == 0;
+}
+
+bool
+readScalar(mbedtls_mpi* m, const std::vector<uint8_t>& v) {
+  return mbedtls_mpi_read_binary(m, v.data(), v.size()) == 0;
+}
+
+/** @brief Compute s = -x * w mod n, as in Context::beginKey(). */
+bool
+negMul(mbedtls_mpi* s, const mbedtls_mpi* x, const mbedtls_mpi* w, const mbedtls_mpi* n) {
+  return mbedtls_mpi_mul_mpi(s, x, w) == 0 && mbedtls_mpi_mod_mpi(s, s, n) == 0 &&
+         mbedtls_mpi_sub_mpi(s, n, s) == 0;
+}
+
+/** @brief Run a computation started in @p ops to completion and encode the result. */
+template<typename Ops>
+std::vector<uint8_t>
+finish(Ops& ops, int ret, unsigned maxOps, size_t len) {
+  if (ret == 0) {
+    do {
+      ret = ops.run(maxOps);
+    } while (ret == MBEDTLS_ERR_ECP_IN_PROGRESS);
+  }
+  std::vector<uint8_t> out(len);
+  if (ret != 0 || ops.writeResult(out.data(), out.size()) != 0) {
+    out.clear();
+  }
+  ops.clear();
+  return out;
+}
+
+/** @brief Compute x * G + w * base. */
+template<typename Ops>
+std::vector<uint8_t>
+share(const mbedtls_mpi* x, typename Ops::Base base, const mbedtls_mpi* w, unsigned maxOps,
+      size_t len) {
+  spake2::Random& random = spake2::Random::forThisThread();
+  Ops ops;
+  int ret = ops.beginShare(x, nullptr, base, w, nullptr, spake2::Random::rng, &random);
+  return finish(ops, ret, maxOps, len);
+}
+
+/** @brief Compute h * (x * P + s * base), and write the canonical encoding of P. */
+template<typename Ops>
+std::vector<uint8_t>
+key(const std::vector<uint8_t>& peer, std::vector<uint8_t>& canonical, const mbedtls_mpi* x,
+    typename Ops::Base base, const mbedtls_mpi* s, unsigned maxOps, size_t len) {
+  spake2::Random& random = spake2::Random::forThisThread();
+  Ops ops;
+  canonical.resize(Ops::PointSize);
+  int ret = ops.beginKey(peer.data(), peer.size(), canonical.data(), x, base, s,
+                         spake2::Random::rng, &random);
+  return finish(ops, ret, maxOps, len);
+}
+
+/** @brief Compute x * base with mulBase(). */
+template<typename Ops>
+std::vector<uint8_t>
+mulBase(const mbedtls_mpi* x, typename Ops::Base base = Ops::Base::G) {
+  spake2::Random& random = spake2::Random::forThisThread();
+  typename Ops::Point P;
+  std::vector<uint8_t> out(Ops::PointSize);
+  if (Ops::mulBase(P, x, spake2::Random::rng, &random, base) != 0 ||
+      Ops::encodePoint(out.data(), out.size(), P) != 0) {
+    out.clear();
+  }
+  Ops::clearPoint(P);
+  return out;
+}
+
+// RFC 9382 Appendix B, SPAKE2-P256-SHA256-HKDF-HMAC with A='server' and B='client'
+const char* const katW = "2ee57912099d31560b3a44b1184b9b4866e904c49d12ac5042c97dca461b1a5f";
+const char* const katX = "43dd0fd7215bdcb482879fca3220c6a968e66d70b1356cac18bb26c84a78d729";
+const char* const katY = "dcb60106f276b02606d8ef0a328c02e4b629f84f89786af5befb0bc75b6e66be";
+const char* const katPA = "04a56fa807caaa53a4d28dbb9853b9815c61a411118a6fe516a8798434751470f9"
+                          "010153ac33d0d5f2047ffdb1a3e42c9b4e6be662766e1eeb4116988ede5f912c";
+const char* const katPB = "0406557e482bd03097ad0cbaa5df82115460d951e3451962f1eaf4367a420676d0"
+                          "9857ccbc522686c83d1852abfa8ed6e4a1155cf8f1543ceca528afb591a1e0b7";
+const char* const katK = "0412af7e89717850671913e6b469ace67bd90a4df8ce45c2af19010175e37eed69"
+                         "f75897996d539356e2fa6a406d528501f907e04d97515fbe83db277b715d3325";
+const char* const katKe = "0e0672dc86f8e45565d338b0540abe69";
+const char* const katCA = "58ad4aa88e0b60d5061eb6b5dd93e80d9c4f00d127c65b3b35b1b5281fee38f0";
+const char* const katCB = "d3e2e547f1ae04f2dbdbf0fc4b79f8ecff2dff314b5d32fe9fcef2fb26dc459b";
+
+/** @brief Check the group operations of a P-256 backend against RFC 9382. */
+template<typename Ops>
+void
+testP256Kat(unsigned maxOps) {
+  using Base = typename Ops::Base;
+  ndnph::mbedtls::Mpi w, x, y, sA, sB;
+  EXPECT(readScalar(w, fromHex(katW)) && readScalar(x, fromHex(katX)) &&
+         readScalar(y, fromHex(katY)));
+  EXPECT(negMul(sA, x, w, Ops::order()) && negMul(sB, y, w, Ops::order()));
+  auto pA = fromHex(katPA);
+  auto pB = fromHex(katPB);
+  auto K = fromHex(katK);
+
+  EXPECT(share<Ops>(x, Base::M, w, maxOps, Ops::PointSize) == pA);
+  EXPECT(share<Ops>(x, Base::M, w, maxOps, Ops::CompressedPointSize) == compress(pA));
+  EXPECT(share<Ops>(y, Base::N, w, maxOps, Ops::PointSize) == pB);
+
+  // Alice receives pB uncompressed, and Bob receives pA compressed
+  std::vector<uint8_t> canonical;
+  EXPECT(key<Ops>(pB, canonical, x, Base::N, sA, maxOps, Ops::PointSize) == K);
+  EXPECT(canonical == pB);
+  EXPECT(key<Ops>(compress(pA), canonical, y, Base::M, sB, maxOps, Ops::PointSize) == K);
+  EXPECT(canonical == pA);
+  EXPECT(key<Ops>(pB, canonical, x, Base::N, sA, maxOps, Ops::CompressedPointSize) ==
+         compress(K));
+}
+
+/** @brief Check a complete exchange on P-256 against RFC 9382. */
+template<spake2::Role role>
+void
+testP256Context(const char* w, const char* x, const char* myShare, const char* peerShare,
+                const char* myMac, const char* peerMac) {
+  using namespace spake2;
+  using Ctx = Context<role, P256, SHA256>;
+  static const uint8_t idA[] = {'s', 'e', 'r', 'v', 'e', 'r'};
+  static const uint8_t idB[] = {'c', 'l', 'i', 'e', 'n', 't'};
+
+  typename Ctx::Checkpoint cp{};
+  auto vW = fromHex(w);
+  auto vX = fromHex(x);
+  auto vShare = fromHex(myShare);
+  std::copy(vW.begin(), vW.end(), cp.w);
+  std::copy(vX.begin(), vX.end(), cp.x);
+  std::copy(vShare.begin(), vShare.end(), cp.share);
+
+  Ctx ctx(Random::forThisThread());
+  bool ok = role == Role::Alice ? ctx.resume(cp, idA, sizeof(idA), idB, sizeof(idB))
+                                : ctx.resume(cp, idB, sizeof(idB), idA, sizeof(idA));
+  cp.clear();
+
+  auto peer = fromHex(peerShare);
+  std::vector<uint8_t> mac(Ctx::SecondMessageSize);
+  ok = ok && ctx.processFirstMessage(peer.data(), peer.size()) &&
+       ctx.generateSecondMessage(mac.data(), mac.size());
+  EXPECT(ok);
+  EXPECT(mac == fromHex(myMac));
+
+  auto expectedMac = fromHex(peerMac);
+  ok = ok && ctx.processSecondMessage(expectedMac.data(), expectedMac.size());
+  EXPECT(ok);
+  if (ok) {
+    auto Ke = fromHex(katKe);
+    EXPECT(std::equal(Ke.begin(), Ke.end(), ctx.getSharedKey().begin()));
+  }
+}
+
+#ifdef PION_SPAKE2_P256_NATIVE
+/** @brief Derive a scalar in [1, n) from a label, for cross-checks on fixed scalars. */
+bool
+deriveScalar(mbedtls_mpi* m, int label, const mbedtls_mpi* n) {
+  uint8_t in[] = {'s', 'c', 'a', 'l', 'a', 'r', static_cast<uint8_t>(label)};
+  uint8_t digest[64];
+  return sha512(in, sizeof(in), digest) &&
+         mbedtls_mpi_read_binary(m, digest, sizeof(digest)) == 0 &&
+         mbedtls_mpi_mod_mpi(m, m, n) == 0 && mbedtls_mpi_cmp_int(m, 0) != 0;
+}
+
+/** @brief Check that P256NativeOps and WeierstrassOps<P256> agree on fixed scalars. */
+void
+testP256Native() {
+  using Native = spake2::detail::P256NativeOps;
+  using Mbed = spake2::detail::WeierstrassOps<spake2::P256>;
+  const mbedtls_mpi* n = Mbed::order();
+  EXPECT(mbedtls_mpi_cmp_mpi(Native::order(), n) == 0);
+
+  for (int i = 0; i < 8; ++i) {
+    ndnph::mbedtls::Mpi x, w, y, s;
+    EXPECT(deriveScalar(x, 3 * i, n) && deriveScalar(w, 3 * i + 1, n) &&
+           deriveScalar(y, 3 * i + 2, n) && negMul(s, x, w, n));
+    EXPECT(mulBase<Native>(x, Native::Base::N) == mulBase<Mbed>(x, Mbed::Base::N));
+
+    unsigned maxOps = i % 2 == 0 ? 0 : 30 * i;
+    auto pA = share<Native>(x, Native::Base::M, w, maxOps, Native::PointSize);
+    EXPECT(!pA.empty() && pA == share<Mbed>(x, Mbed::Base::M, w, maxOps, Mbed::PointSize));
+    EXPECT(share<Native>(x, Native::Base::M, w, maxOps, Native::CompressedPointSize) ==
+           share<Mbed>(x, Mbed::Base::M, w, maxOps, Mbed::CompressedPointSize));
+
+    auto pB = share<Native>(y, Native::Base::N, w, maxOps, Native::PointSize);
+    EXPECT(!pB.empty() && pB == share<Mbed>(y, Mbed::Base::N, w, maxOps, Mbed::PointSize));
+    std::vector<uint8_t> cNative, cMbed;
+    auto kNative =
+      key<Native>(compress(pB), cNative, x, Native::Base::N, s, maxOps, Native::PointSize);
+    auto kMbed = key<Mbed>(compress(pB), cMbed, x, Mbed::Base::N, s, maxOps, Mbed::PointSize);
+    EXPECT(!kNative.empty() && kNative == kMbed);
+    EXPECT(cNative == pB && cMbed == pB);
+  }
+}
+#endif // PION_SPAKE2_P256_NATIVE
+
+/** @brief Check edwards25519 against the public keys of RFC 8032 section 7.1. */
+void
+testEdwards25519() {
+  using Ops = spake2::detail::Edwards25519Ops;
+  const mbedtls_mpi* L = Ops::order();
+
+  // multiples of the base point
+  static const char* const multiples[] = {
+    "5866666666666666666666666666666666666666666666666666666666666666",
+    "c9a3f86aae465f0e56513864510f3997561fa2c9e85ea21dc2292309f3cd6022",
+    "d4b4f5784868c3020403246717ec169ff79e26608ea126a1ab69ee77d1b16712",
+  };
+  for (int i = 0; i < 3; ++i) {
+    ndnph::mbedtls::Mpi k;
+    EXPECT(mbedtls_mpi_lset(k, i + 1) == 0);
+    EXPECT(mulBase<Ops>(k) == fromHex(multiples[i]));
+  }
+
+  // TEST 1 to TEST 3: SECRET KEY and PUBLIC KEY
+  static const char* const keys[][2] = {
+    {"9d61b19deffd5a60ba844af492ec2cc44449c5697b326919703bac031cae7f60",
+     "d75a980182b10ab7d54bfed3c964073a0ee172f3daa62325af021a68f707511a"},
+    {"4ccd089b28ff96da9db6c346ec114e0f5b8a319f35aba624da8cf6ed4fb8a6fb",
+     "3d4017c3e843895a92b70aa74d1b7ebc9c982ccf2ec4968cc0cd55f12af4660c"},
+    {"c5aa8df43f9f837bedb7442f31dcb7b166d38535076f094b85ce3a2e0b4458f7",
+     "fc51cd8e6218a1a38da47ed00230f0580816ed13ba3303ac5deb911548908025"},
+  };
+  ndnph::mbedtls::Mpi a[3];
+  for (int i = 0; i < 3; ++i) {
+    // the secret scalar is the clamped first half of SHA-512(secret key), little endian
+    auto secret = fromHex(keys[i][0]);
+    uint8_t h[64];
+    EXPECT(sha512(secret.data(), secret.size(), h));
+    h[0] &= 0xF8;
+    h[31] = static_cast<uint8_t>((h[31] & 0x7F) | 0x40);
+    std::reverse(h, h + 32);
+    EXPECT(mbedtls_mpi_read_binary(a[i], h, 32) == 0 && mbedtls_mpi_mod_mpi(a[i], a[i], L) == 0);
+
+    auto pub = fromHex(keys[i][1]);
+    EXPECT(mulBase<Ops>(a[i]) == pub);
+
+    Ops::Point P;
+    std::vector<uint8_t> encoded(Ops::PointSize);
+    EXPECT(Ops::decodePoint(P, pub.data(), pub.size()) == 0 &&
+           Ops::encodePoint(encoded.data(), encoded.size(), P) == 0 && encoded == pub);
+  }
+
+  for (unsigned maxOps : {0U, 1U, 100U}) {
+    // additions and doublings of the joint multiplication: a0 * B + a1 * B
+    ndnph::mbedtls::Mpi sum;
+    EXPECT(mbedtls_mpi_add_mpi(sum, a[0], a[1]) == 0 && mbedtls_mpi_mod_mpi(sum, sum, L) == 0);
+    EXPECT(share<Ops>(a[0], Ops::Base::G, a[1], maxOps, Ops::PointSize) == mulBase<Ops>(sum));
+
+    // multiplication of a decoded point: 8 * (a2 * (a0 * B) + a1 * B)
+    ndnph::mbedtls::Mpi k;
+    EXPECT(mbedtls_mpi_mul_mpi(k, a[2], a[0]) == 0 && mbedtls_mpi_add_mpi(k, k, a[1]) == 0 &&
+           mbedtls_mpi_mul_int(k, k, 8) == 0 && mbedtls_mpi_mod_mpi(k, k, L) == 0);
+    auto pub = fromHex(keys[0][1]);
+    std::vector<uint8_t> canonical;
+    EXPECT(key<Ops>(pub, canonical, a[2], Ops::Base::G, a[1], maxOps, Ops::PointSize) ==
+           mulBase<Ops>(k));
+    EXPECT(canonical == pub);
+  }
+}
+
+/** @brief Check that Random is seeded on first use. */
+void
+testRandom() {
+  spake2::Random random;
+  EXPECT(!random.isSeeded());
+  uint8_t a[32], b[32];
+  EXPECT(random.generate(a, sizeof(a)) && random.isSeeded());
+  EXPECT(random.seed() && random.generate(b, sizeof(b)));
+  EXPECT(!std::equal(a, a + sizeof(a), b));
+}
+
+/** @brief Check that Verifier::assign() copies w and the precomputed points. */
+void
+testVerifier() {
+  using V = spake2::Verifier<spake2::P256>;
+  static const uint8_t pw[] = {'p', 'a', 's', 's', 'w', 'o', 'r', 'd'};
+  V v, copy;
+  EXPECT(v.compute(pw, sizeof(pw), V::WithN, spake2::Random::forThisThread()));
+  EXPECT(copy.assign(v));
+
+  std::vector<uint8_t> encoded(V::MaxEncodedSize), copyEncoded(V::MaxEncodedSize);
+  encoded.resize(v.encode(encoded.data(), encoded.size()));
+  copyEncoded.resize(copy.encode(copyEncoded.data(), copyEncoded.size()));
+  EXPECT(!encoded.empty() && copyEncoded == encoded);
+
+  V invalid;
+  EXPECT(!copy.assign(invalid) && !copy.isValid());
+}
+
+} // namespace
+
+int
+main() {
+  using namespace spake2;
+  testRandom();
+  testVerifier();
+  for (unsigned maxOps : {0U, 30U}) {
+    testP256Kat<detail::WeierstrassOps<P256>>(maxOps);
+#ifdef PION_SPAKE2_P256_NATIVE
+    testP256Kat<detail::P256NativeOps>(maxOps);
+#endif
+  }
+#ifdef PION_SPAKE2_P256_NATIVE
+  testP256Native();
+#endif
+  testP256Context<Role::Alice>(katW, katX, katPA, katPB, katCA, katCB);
+  testP256Context<Role::Bob>(katW, katY, katPB, katPA, katCB, katCA);
+  testEdwards25519();
+
+  if (nFailures > 0) {
+    fprintf(stderr, "%d checks failed\n", nFailures);
+    return 1;
+  }
+  return 0;
+}
@@ -3,50 +3,48 @@
 namespace pion {
 namespace pake {
 
-static mbed::Entropy entropy;
+// each thread running authenticators has its own DRBG and pools
+static thread_local Spake2AuthenticatorPool spake2Pool(spake2::Random::forThisThread());
+static thread_local Spake2EphemeralPool ephemeralPool(spake2::Random::forThisThread());
 
 class Authenticator::GotoState {
 public:
-  explicit GotoState(Authenticator* authenticator)
-    : m_authenticator(authenticator) {}
+  explicit GotoState(Session& session)
+    : m_session(session) {}
 
   bool operator()(State state) {
-    m_authenticator->m_state = state;
+    m_session.m_state = state;
     m_set = true;
     return true;
   }
 
   ~GotoState() {
     if (!m_set) {
-      m_authenticator->m_state = State::Failure;
+      m_session.m_state = State::Failure;
     }
   }
 
 private:
-  Authenticator* m_authenticator;
+  Session& m_session;
   bool m_set = false;
 };
 
 class Authenticator::PakeRequest : public packet_struct::PakeRequest {
 public:
-  ndnph::Interest::Parameterized toInterest(ndnph::Region& region, EncryptSession& session) const {
+  ndnph::tlv::Value toParameters(ndnph::Region& region) const {
     ndnph::Encoder encoder(region);
     encoder.prepend(
       [this](ndnph::Encoder& encoder) {
-        encoder.prependTlv(TT::Spake2PA, ndnph::tlv::Value(spake2pa, sizeof(spake2pa)));
+        encoder.prependTlv(TT::Spake2PA, ndnph::tlv::Value(spake2pa, spake2paLen));
       },
       [this](ndnph::Encoder& encoder) {
         encoder.prependTlv(TT::AuthenticatorCertName, authenticatorCertName);
       });
     encoder.trim();
-
-    ndnph::Interest interest = region.create<ndnph::Interest>();
-    if (!encoder || !interest) {
-      return ndnph::Interest::Parameterized();
+    if (!encoder) {
+      return ndnph::tlv::Value();
     }
-    interest.setName(session.makeName(region, getPakeComponent()));
-    interest.setLifetime(InterestLifetime::value);
-    return interest.parameterize(ndnph::tlv::Value(encoder));
+    return ndnph::tlv::Value(encoder);
   }
 };
 
@@ -56,8 +54,10 @@ public:
     return ndnph::EvDecoder::decodeValue(
       data.getContent().makeDecoder(),
       ndnph::EvDecoder::def<TT::Spake2PB>([this](const ndnph::Decoder::Tlv& d) {
-        if (d.length == sizeof(spake2pb)) {
+        if (d.length == sizeof(spake2pb) ||
+            d.length == Spake2Authenticator::CompressedFirstMessageSize) {
           std::copy_n(d.value, d.length, spake2pb);
+          spake2pbLen = d.length;
           return true;
         }
         return false;
@@ -74,7 +74,7 @@ public:
 
 class Authenticator::ConfirmRequest : public packet_struct::ConfirmRequest {
 public:
-  ndnph::Interest::Parameterized toInterest(ndnph::Region& region, EncryptSession& session) const {
+  ndnph::tlv::Value toParameters(ndnph::Region& region, EncryptSession& session) const {
     auto encrypted = session.encrypt(
       region, [this](ndnph::Encoder& encoder) { encoder.prependTlv(TT::Nc, nc); },
       [this](ndnph::Encoder& encoder) { encoder.prependTlv(TT::CaProfileName, caProfileName); },
@@ -88,14 +88,10 @@ public:
       },
       encrypted);
     outer.trim();
-
-    ndnph::Interest interest = region.create<ndnph::Interest>();
-    if (!encrypted || !outer || !interest) {
-      return ndnph::Interest::Parameterized();
+    if (!encrypted || !outer) {
+      return ndnph::tlv::Value();
     }
-    interest.setName(session.makeName(region, getConfirmComponent()));
-    interest.setLifetime(InterestLifetime::value);
-    return interest.parameterize(ndnph::tlv::Value(outer));
+    return ndnph::tlv::Value(outer);
   }
 };
 
@@ -127,21 +123,22 @@ public:
 
 class Authenticator::CredentialRequest : public packet_struct::CredentialRequest {
 public:
-  ndnph::Interest::Parameterized toInterest(ndnph::Region& region, EncryptSession& session) const {
-    auto encrypted = session.encrypt(region, [this](ndnph::Encoder& encoder) {
+  ndnph::tlv::Value toParameters(ndnph::Region& region, EncryptSession& session) const {
+    return session.encrypt(region, [this](ndnph::Encoder& encoder) {
       encoder.prependTlv(TT::IssuedCertName, tempCertName);
     });
-
-    ndnph::Interest interest = region.create<ndnph::Interest>();
-    if (!encrypted || !interest) {
-      return ndnph::Interest::Parameterized();
-    }
-    interest.setName(session.makeName(region, getCredentialComponent()));
-    interest.setLifetime(InterestLifetime::value);
-    return interest.parameterize(encrypted);
   }
 };
 
+Authenticator::Session::Session(Authenticator* authenticator, std::unique_ptr<uint8_t[]> block)
+  : m_block(std::move(block))
+  , m_region(m_block.get(), SessionRegionSize)
+  , m_pending(authenticator) {}
+
+Authenticator::Session::~Session() {
+  m_spake2.clear();
+}
+
 Authenticator::Authenticator(const Options& opts)
   : PacketHandler(opts.face, 192)
   , m_caProfile(opts.caProfile)
@@ -149,77 +146,186 @@ Authenticator::Authenticator(const Options& opts)
   , m_signer(opts.signer)
   , m_nc(opts.nc)
   , m_deviceName(opts.deviceName)
-  , m_pending(this)
-  , m_region(4096) {}
+  , m_compressPoints(opts.compressPoints)
+  , m_spake2Arena(opts.spake2Arena) {
+  m_hasSpakeIdentity = m_cert.computeImplicitDigest(m_spakeIdentity);
+}
 
 void
 Authenticator::end() {
-  m_session.end();
-  m_spake2.reset();
-  m_state = State::Idle;
-  m_region.reset();
+  m_main = nullptr;
+  m_issuedCerts.clear();
+  for (auto& entry : m_sessions) {
+    recycle(*entry.second);
+  }
+  m_sessions.clear();
 }
 
 bool
 Authenticator::begin(ndnph::tlv::Value password) {
   end();
+  m_main = addSession(password, m_deviceName, m_nc);
+  return m_main != nullptr;
+}
 
-  if (!m_session.begin(m_region)) {
-    return false;
+uint64_t
+Authenticator::makeKey(const uint8_t* value) {
+  uint64_t key = 0;
+  std::copy_n(value, sizeof(key), reinterpret_cast<uint8_t*>(&key));
+  return key;
+}
+
+std::unique_ptr<uint8_t[]>
+Authenticator::takeBlock() {
+  if (m_freeBlocks.empty()) {
+    return std::unique_ptr<uint8_t[]>(new uint8_t[SessionRegionSize]);
+  }
+  std::unique_ptr<uint8_t[]> block = std::move(m_freeBlocks.back());
+  m_freeBlocks.pop_back();
+  return block;
+}
+
+void
+Authenticator::recycle(Session& s) {
+  s.m_retx.end();
+  s.m_spake2.clear();
+  s.m_session.end();
+  s.m_issued = ndnph::Data();
+  s.m_region.reset();
+  m_freeBlocks.push_back(std::move(s.m_block));
+}
+
+Authenticator::Session*
+Authenticator::addSession(ndnph::tlv::Value password, ndnph::Name deviceName,
+                          ndnph::tlv::Value nc) {
+  if (!m_hasSpakeIdentity) {
+    return nullptr;
+  }
+  std::unique_ptr<Session> s(new Session(this, takeBlock()));
+  s->m_retx.begin();
+  s->m_deviceName = deviceName;
+  s->m_nc = nc;
+  bool ok = s->m_session.begin(s->m_region, spake2::Random::forThisThread());
+  if (ok) {
+    s->m_id = makeKey(s->m_session.ss.value());
+    ok = m_sessions.count(s->m_id) == 0;
+  }
+
+  if (ok) {
+    // the context is only borrowed until the share is computed: the session keeps a Checkpoint,
+    // so that waiting sessions do not hold contexts
+    auto spake2 = spake2Pool.acquire();
+    spake2->setArena(m_spake2Arena);
+    uint8_t share[Spake2Authenticator::FirstMessageSize];
+    ok = spake2->start(password.begin(), password.size(), m_spakeIdentity,
+                       sizeof(m_spakeIdentity), nullptr, 0, s->m_session.ss.value(),
+                       s->m_session.ss.length());
+    if (ok) {
+      // use a precomputed ephemeral share if available, otherwise x*G is computed now
+      spake2->takeEphemeral(ephemeralPool);
+      ok = spake2->generateFirstMessage(share, sizeof(share)) && spake2->suspend(s->m_spake2);
+    }
   }
 
-  m_spake2.reset(new Spake2Authenticator(entropy));
-  uint8_t spakeIdentity[NDNPH_SHA256_LEN];
-  bool ok = m_cert.computeImplicitDigest(spakeIdentity) &&
-            m_spake2->start(password.begin(), password.size(), spakeIdentity, sizeof(spakeIdentity),
-                            nullptr, 0, m_session.ss.value(), m_session.ss.length());
   if (!ok) {
-    return false;
+    recycle(*s);
+    return nullptr;
   }
+  s->m_state = State::SendPakeRequest;
+  Session* session = s.get();
+  m_sessions.emplace(s->m_id, std::move(s));
+  return session;
+}
 
-  m_state = State::SendPakeRequest;
-  return true;
+void
+Authenticator::removeSession(Session* session) {
+  if (session == nullptr) {
+    return;
+  }
+  if (session == m_main) {
+    m_main = nullptr;
+  }
+  if (!!session->m_issued) {
+    m_issuedCerts.erase(session->m_issuedKey);
+  }
+  recycle(*session);
+  m_sessions.erase(session->m_id);
+}
+
+Authenticator::Session*
+Authenticator::findSession(const ndnph::Name& name) const {
+  ndnph::Name prefix = getPionPrefix();
+  if (name.size() <= prefix.size() || !prefix.isPrefixOf(name)) {
+    return nullptr;
+  }
+  ndnph::Component comp = name[prefix.size()];
+  if (comp.length() != sizeof(uint64_t)) {
+    return nullptr;
+  }
+  auto it = m_sessions.find(makeKey(comp.value()));
+  return it == m_sessions.end() ? nullptr : it->second.get();
 }
 
 void
 Authenticator::loop() {
-  switch (m_state) {
-    case State::SendPakeRequest: {
-      sendPakeRequest();
-      break;
-    }
-    case State::SendCredentialRequest: {
-      sendCredentialRequest();
-      break;
-    }
-    case State::WaitPakeResponse:
-    case State::WaitConfirmResponse:
-    case State::WaitCredentialResponse: {
-      if (m_pending.expired()) {
-        m_state = State::Failure;
+  for (auto& entry : m_sessions) {
+    Session& s = *entry.second;
+    switch (s.m_state) {
+      case State::SendPakeRequest: {
+        sendPakeRequest(s);
+        break;
       }
-      break;
+      case State::SendCredentialRequest: {
+        sendCredentialRequest(s);
+        break;
+      }
+      case State::WaitPakeResponse:
+      case State::WaitConfirmResponse:
+      case State::WaitCredentialResponse: {
+        switch (s.m_retx.poll()) {
+          case Retransmitter::Action::Retransmit: {
+            if (!s.m_retx.transmit(s.m_pending)) {
+              s.m_state = State::Failure;
+            }
+            break;
+          }
+          case Retransmitter::Action::Expired: {
+            s.m_state = State::Failure;
+            break;
+          }
+          default:
+            break;
+        }
+        break;
+      }
+      default:
+        break;
     }
-    default:
-      break;
   }
+
+  // Precompute ephemeral shares for future sessions in the background;
+  // at most one scalar multiplication per iteration, so that packet processing is not delayed much
+  ephemeralPool.refill(1);
 }
 
 bool
 Authenticator::processData(ndnph::Data data) {
-  if (!m_pending.matchPitToken()) {
+  Session* s = findSession(data.getName());
+  // after a retransmission, a reply to an earlier transmission carries an older PIT token; the name
+  // check ensures that such a reply answers the Interest of the current step
+  if (s == nullptr || !s->m_retx.matchName(data.getName()) ||
+      !(s->m_pending.matchPitToken() || s->m_retx.hasRetransmitted())) {
     return false;
   }
-  switch (m_state) {
+  switch (s->m_state) {
     case State::WaitPakeResponse: {
-      return handlePakeResponse(data);
+      return handlePakeResponse(*s, data);
     }
     case State::WaitConfirmResponse: {
-      return handleConfirmResponse(data);
+      return handleConfirmResponse(*s, data);
     }
     case State::WaitCredentialResponse: {
-      m_state = State::Success;
-      return true;
+      return handleCredentialResponse(*s, data);
     }
     default:
       break;
@@ -228,59 +334,87 @@ Authenticator::processData(ndnph::Data data) {
 }
 
 void
-Authenticator::sendPakeRequest() {
+Authenticator::sendPakeRequest(Session& s) {
   ndnph::StaticRegion<2048> region;
-  GotoState gotoState(this);
+  GotoState gotoState(s);
   PakeRequest req;
   req.authenticatorCertName = m_cert.getFullName(region);
-  m_spake2->generateFirstMessage(req.spake2pa, sizeof(req.spake2pa)) &&
-    m_pending.send(req.toInterest(region, m_session)) && gotoState(State::WaitPakeResponse);
+  if (m_compressPoints) {
+    req.spake2paLen = Spake2Authenticator::CompressedFirstMessageSize;
+  }
+  s.m_spake2.writeShare(req.spake2pa, req.spake2paLen) &&
+    sendRequest(s, Request::Pake, req.toParameters(region)) && gotoState(State::WaitPakeResponse);
+}
+
+bool
+Authenticator::sendRequest(Session& s, Request type, ndnph::tlv::Value params) {
+  static const ndnph::Component verbs[]{
+    getPakeComponent(),
+    getConfirmComponent(),
+    getCredentialComponent(),
+  };
+
+  ndnph::StaticRegion<128> region;
+  ndnph::Name name = s.m_session.makeName(region, verbs[static_cast<int>(type)]);
+  if (!name || !params) {
+    return false;
+  }
+  s.m_retx.save(name, params, s.m_counters[static_cast<int>(type)]);
+  return s.m_retx.transmit(s.m_pending);
 }
 
 bool
-Authenticator::handlePakeResponse(ndnph::Data data) {
+Authenticator::handlePakeResponse(Session& s, ndnph::Data data) {
   ndnph::StaticRegion<2048> region;
   PakeResponse res;
   if (!res.fromData(region, data)) {
     return false;
   }
+  s.m_retx.satisfy();
 
-  GotoState gotoState(this);
+  GotoState gotoState(s);
   ConfirmRequest req;
-  bool ok = m_spake2->processFirstMessage(res.spake2pb, sizeof(res.spake2pb)) &&
-            m_spake2->generateSecondMessage(req.spake2ca, sizeof(req.spake2ca)) &&
-            m_spake2->processSecondMessage(res.spake2cb, sizeof(res.spake2cb)) &&
-            m_session.importKey(m_spake2->getSharedKey());
-  m_spake2.reset();
+  auto spake2 = spake2Pool.acquire();
+  spake2->setArena(m_spake2Arena);
+  bool ok = spake2->resume(s.m_spake2, m_spakeIdentity, sizeof(m_spakeIdentity), nullptr, 0,
+                           s.m_session.ss.value(), s.m_session.ss.length()) &&
+            spake2->processFirstMessage(res.spake2pb, res.spake2pbLen) &&
+            spake2->generateSecondMessage(req.spake2ca, sizeof(req.spake2ca)) &&
+            spake2->processSecondMessage(res.spake2cb, sizeof(res.spake2cb)) &&
+            s.m_session.importKey(spake2->getSharedKey());
+  spake2.reset();
+  s.m_spake2.clear();
   if (!ok) {
     return true;
   }
 
-  req.nc = m_nc;
+  req.nc = s.m_nc;
   req.caProfileName = m_caProfile.getFullName(region);
-  req.deviceName = m_deviceName;
+  req.deviceName = s.m_deviceName;
   // req.timestamp is ignored; current timestamp will be used
-  m_pending.send(req.toInterest(region, m_session)) && gotoState(State::WaitConfirmResponse);
+  sendRequest(s, Request::Confirm, req.toParameters(region, s.m_session)) &&
+    gotoState(State::WaitConfirmResponse);
   return true;
 }
 
 bool
-Authenticator::handleConfirmResponse(ndnph::Data data) {
+Authenticator::handleConfirmResponse(Session& s, ndnph::Data data) {
   ndnph::StaticRegion<2048> region;
   ConfirmResponse res;
-  if (!res.fromData(region, data, m_session)) {
+  if (!res.fromData(region, data, s.m_session)) {
     return false;
   }
+  s.m_retx.satisfy();
 
-  GotoState gotoState(this);
-  auto subjectName = computeTempSubjectName(region, m_cert.getName(), m_deviceName);
+  GotoState gotoState(s);
+  auto subjectName = computeTempSubjectName(region, m_cert.getName(), s.m_deviceName);
   if (ndnph::certificate::toSubjectName(region, res.tempCertReq.getName()) != subjectName) {
     return true;
   }
 
   time_t now = time(nullptr);
   ndnph::ValidityPeriod validity(now, now + TempCertValidity::value);
-  ndnph::Encoder encoder(m_region);
+  ndnph::Encoder encoder(s.m_region);
   encoder.prepend(res.tPub.buildCertificate(region, subjectName, validity, m_signer));
   if (!encoder) {
     encoder.discard();
@@ -288,21 +422,41 @@ Authenticator::handleConfirmResponse(ndnph::Data data) {
   }
   encoder.trim();
 
-  m_issued = m_region.create<ndnph::Data>();
-  return !!m_issued && ndnph::tlv::Value(encoder).makeDecoder().decode(m_issued) &&
-         gotoState(State::SendCredentialRequest);
+  s.m_issued = s.m_region.create<ndnph::Data>();
+  uint8_t digest[NDNPH_SHA256_LEN];
+  if (!s.m_issued || !ndnph::tlv::Value(encoder).makeDecoder().decode(s.m_issued) ||
+      !s.m_issued.computeImplicitDigest(digest)) {
+    return true;
+  }
+  s.m_issuedKey = makeKey(digest);
+  m_issuedCerts[s.m_issuedKey] = &s;
+  return gotoState(State::SendCredentialRequest);
 }
 
 void
-Authenticator::sendCredentialRequest() {
+Authenticator::sendCredentialRequest(Session& s) {
   ndnph::StaticRegion<2048> region;
-  GotoState gotoState(this);
+  GotoState gotoState(s);
   CredentialRequest req;
-  req.tempCertName = m_issued.getFullName(region);
-  !!req.tempCertName && m_pending.send(req.toInterest(region, m_session)) &&
+  req.tempCertName = s.m_issued.getFullName(region);
+  !!req.tempCertName &&
+    sendRequest(s, Request::Credential, req.toParameters(region, s.m_session)) &&
     gotoState(State::WaitCredentialResponse);
 }
 
+bool
+Authenticator::handleCredentialResponse(Session& s, ndnph::Data data) {
+  // the device signs the acknowledgement with the key of the issued certificate
+  ndnph::StaticRegion<1024> region;
+  ndnph::EcPublicKey tPub;
+  if (!tPub.import(region, s.m_issued) || !data.verify(tPub)) {
+    return false;
+  }
+  s.m_retx.satisfy();
+  s.m_state = State::Success;
+  return true;
+}
+
 bool
 Authenticator::processInterest(ndnph::Interest interest) {
   if (m_caProfile.canSatisfy(interest)) {
@@ -311,10 +465,22 @@ Authenticator::processInterest(ndnph::Interest interest) {
   if (m_cert.canSatisfy(interest)) {
     return reply(m_cert);
   }
-  if (!!m_issued && m_issued.canSatisfy(interest)) {
-    return reply(m_issued);
+
+  // the device fetches the issued certificate by its full name, which ends with the implicit digest
+  const ndnph::Name& name = interest.getName();
+  if (name.size() == 0) {
+    return false;
   }
-  return false;
+  ndnph::Component last = name[name.size() - 1];
+  if (last.type() != ndnph::TT::ImplicitSha256DigestComponent ||
+      last.length() != NDNPH_SHA256_LEN) {
+    return false;
+  }
+  auto it = m_issuedCerts.find(makeKey(last.value()));
+  if (it == m_issuedCerts.end() || !it->second->m_issued.canSatisfy(interest)) {
+    return false;
+  }
+  return reply(it->second->m_issued);
 }
 
 } // namespace pake
@@ -3,10 +3,29 @@
 
 #include "packet.hpp"
 
+#include <unordered_map>
+#include <vector>
+
 namespace pion {
 namespace pake {
 
-/** @brief PION Onboarding Protocol - PAKE stage, authenticator side. */
+/**
+ * @brief PION Onboarding Protocol - PAKE stage, authenticator side.
+ *
+ * One authenticator can onboard several devices at once. Each device has its own Session, with an
+ * independent state machine and memory region. Sessions are identified by the session ID name
+ * component: incoming Data are demultiplexed by the session ID in their names, and Interests for
+ * issued certificates by the implicit digest in their names. The CA profile and authenticator
+ * certificate are shared by all sessions.
+ *
+ * A session keeps only what it needs between messages: while it waits for the PAKE response, its
+ * SPAKE2 context is suspended into a Checkpoint and returned to the pool; its region is a block of
+ * SessionRegionSize octets taken from a free list, which holds the session ID and the issued
+ * certificate. See docs/fwsize.md for the memory used per session.
+ *
+ * A request Interest that is not answered within the retransmission timeout is retransmitted,
+ * until the session reaches ProtocolTimeLimit since it was started.
+ */
 class Authenticator : public ndnph::PacketHandler {
 public:
   struct Options {
@@ -22,17 +41,35 @@ public:
     /** @brief Authenticator signer. */
     const ndnph::PrivateKey& signer;
 
-    /** @brief Network credential to be passed to the device. */
+    /** @brief Network credential to be passed to the device, used by begin(). */
     ndnph::tlv::Value nc;
 
-    /** @brief Assigned device name. */
+    /** @brief Assigned device name, used by begin(). */
     ndnph::Name deviceName;
+
+    /**
+     * @brief Whether to send the SPAKE2 share as a compressed point.
+     *
+     * The device replies in the same format.
+     */
+    bool compressPoints;
+
+    /**
+     * @brief Arena for the bignum allocations of SPAKE2, or nullptr to use the heap.
+     * @sa spake2::Context::setArena()
+     */
+    spake2::Arena* spake2Arena;
   };
 
   explicit Authenticator(const Options& opts);
 
+  /** @brief End all sessions. */
   void end();
 
+  /**
+   * @brief End all sessions, then start one with the device in Options.
+   * @sa getState()
+   */
   bool begin(ndnph::tlv::Value password);
 
   enum class State {
@@ -46,8 +83,87 @@ public:
     Failure,
   };
 
+  enum {
+    /** @brief Capacity of the region of each session. */
+    SessionRegionSize = 1024,
+  };
+
+  /** @brief Interest sent by the authenticator. */
+  enum class Request {
+    Pake,
+    Confirm,
+    Credential,
+  };
+
+  /** @brief Onboarding session of one device. */
+  class Session {
+  public:
+    State getState() const {
+      return m_state;
+    }
+
+    const ndnph::Name& getDeviceName() const {
+      return m_deviceName;
+    }
+
+    /** @brief Return retransmission and latency counters of a type of Interest. */
+    const RetxCounters& getCounters(Request type) const {
+      return m_counters[static_cast<int>(type)];
+    }
+
+    /** @brief Return smoothed RTT in milliseconds, or -1 if there is no sample. */
+    int getSrtt() const {
+      return m_retx.getSrtt();
+    }
+
+    ~Session();
+
+  private:
+    Session(Authenticator* authenticator, std::unique_ptr<uint8_t[]> block);
+
+  private:
+    friend Authenticator;
+
+    std::unique_ptr<uint8_t[]> m_block; // from Authenticator::m_freeBlocks
+    ndnph::Region m_region;
+    ndnph::tlv::Value m_nc;
+    ndnph::Name m_deviceName;
+
+    OutgoingPendingInterest m_pending;
+    Retransmitter m_retx;
+    RetxCounters m_counters[3];
+    State m_state = State::Idle;
+
+    EncryptSession m_session;
+    uint64_t m_id = 0;
+    Spake2Authenticator::Checkpoint m_spake2; // valid in SendPakeRequest and WaitPakeResponse
+    ndnph::Data m_issued;
+    uint64_t m_issuedKey = 0;
+  };
+
+  /**
+   * @brief Start a session with a device, alongside the existing sessions.
+   * @param password PAKE password of the device.
+   * @param deviceName assigned device name.
+   * @param nc network credential to be passed to the device.
+   * @return the session, or nullptr on failure. It remains valid until removeSession() or end().
+   */
+  Session* addSession(ndnph::tlv::Value password, ndnph::Name deviceName, ndnph::tlv::Value nc);
+
+  /** @brief End a session and release its resources. */
+  void removeSession(Session* session);
+
+  /** @brief Return number of sessions, including finished ones. */
+  size_t size() const {
+    return m_sessions.size();
+  }
+
+  /**
+   * @brief Return the state of the session started by begin().
+   * @return the state, or State::Idle if there is no such session.
+   */
   State getState() const {
-    return m_state;
+    return m_main == nullptr ? State::Idle : m_main->getState();
   }
 
 private:
@@ -55,16 +171,37 @@ private:
 
   bool processData(ndnph::Data data) final;
 
-  void sendPakeRequest();
+  void sendPakeRequest(Session& s);
+
+  /** @brief Send a request Interest and save it for retransmissions. */
+  bool sendRequest(Session& s, Request type, ndnph::tlv::Value params);
+
+  bool handlePakeResponse(Session& s, ndnph::Data data);
 
-  bool handlePakeResponse(ndnph::Data data);
+  bool handleConfirmResponse(Session& s, ndnph::Data data);
 
-  bool handleConfirmResponse(ndnph::Data data);
+  void sendCredentialRequest(Session& s);
 
-  void sendCredentialRequest();
+  /** @brief Accept the credential response if it is signed by the key of the issued certificate. */
+  bool handleCredentialResponse(Session& s, ndnph::Data data);
 
   bool processInterest(ndnph::Interest interest) final;
 
+  /** @brief Take a block for a session region. */
+  std::unique_ptr<uint8_t[]> takeBlock();
+
+  /** @brief End a session, keeping its region block for reuse. */
+  void recycle(Session& s);
+
+  /** @brief Find the session whose ID appears in @p name . */
+  Session* findSession(const ndnph::Name& name) const;
+
+  /**
+   * @brief Derive a hash table key from the leading octets of a random or digest component.
+   * @pre length >= 8
+   */
+  static uint64_t makeKey(const uint8_t* value);
+
 private:
   class GotoState;
   class PakeRequest;
@@ -78,14 +215,19 @@ private:
   const ndnph::PrivateKey& m_signer;
   ndnph::tlv::Value m_nc;
   ndnph::Name m_deviceName;
-
-  OutgoingPendingInterest m_pending;
-  State m_state = State::Idle;
-
-  ndnph::DynamicRegion m_region;
-  EncryptSession m_session;
-  std::unique_ptr<Spake2Authenticator> m_spake2;
-  ndnph::Data m_issued;
+  bool m_compressPoints;
+  spake2::Arena* m_spake2Arena;
+  uint8_t m_spakeIdentity[NDNPH_SHA256_LEN]; // implicit digest of m_cert
+  bool m_hasSpakeIdentity = false;
+
+  /** @brief Region blocks of ended sessions, kept for reuse. */
+  std::vector<std::unique_ptr<uint8_t[]>> m_freeBlocks;
+  /** @brief Sessions by session ID. */
+  std::unordered_map<uint64_t, std::unique_ptr<Session>> m_sessions;
+  /** @brief Sessions by implicit digest of the issued certificate. */
+  std::unordered_map<uint64_t, Session*> m_issuedCerts;
+  /** @brief Session started by begin(). */
+  Session* m_main = nullptr;
 };
 
 } // namespace pake
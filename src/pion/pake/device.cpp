@@ -3,7 +3,19 @@
 namespace pion {
 namespace pake {
 
-static mbed::Entropy entropy;
+// The DRBG is constructed on first use and seeded in beginPake(), because static initialization
+// may run before the entropy source of the platform is ready.
+static spake2::Random&
+getRandom() {
+  static spake2::Random random;
+  return random;
+}
+
+static Spake2DevicePool&
+getSpake2Pool() {
+  static Spake2DevicePool pool(getRandom());
+  return pool;
+}
 
 class Device::GotoState {
 public:
@@ -36,8 +48,9 @@ public:
     return ndnph::EvDecoder::decodeValue(
       interest.getAppParameters().makeDecoder(),
       ndnph::EvDecoder::def<TT::Spake2PA>([this](const ndnph::Decoder::Tlv& d) {
-        if (d.length == sizeof(spake2pa)) {
+        if (d.length == sizeof(spake2pa) || d.length == Spake2Device::CompressedFirstMessageSize) {
           std::copy_n(d.value, d.length, spake2pa);
+          spake2paLen = d.length;
           return true;
         }
         return false;
@@ -52,11 +65,11 @@ public:
 
 class Device::PakeResponse : public packet_struct::PakeResponse {
 public:
-  ndnph::Data::Signed toData(ndnph::Region& region, const ndnph::Interest& pakeRequest) const {
+  ndnph::Data::Signed toData(ndnph::Region& region, const ndnph::Name& pakeRequestName) const {
     ndnph::Encoder encoder(region);
     encoder.prepend(
       [this](ndnph::Encoder& encoder) {
-        encoder.prependTlv(TT::Spake2PB, ndnph::tlv::Value(spake2pb, sizeof(spake2pb)));
+        encoder.prependTlv(TT::Spake2PB, ndnph::tlv::Value(spake2pb, spake2pbLen));
       },
       [this](ndnph::Encoder& encoder) {
         encoder.prependTlv(TT::Spake2CB, ndnph::tlv::Value(spake2cb, sizeof(spake2cb)));
@@ -64,10 +77,10 @@ public:
     encoder.trim();
 
     ndnph::Data data = region.create<ndnph::Data>();
-    if (!encoder || !data || !pakeRequest) {
+    if (!encoder || !data) {
       return ndnph::Data::Signed();
     }
-    data.setName(pakeRequest.getName());
+    data.setName(pakeRequestName);
     data.setContent(ndnph::tlv::Value(encoder));
     return data.sign(ndnph::NullKey::get());
   }
@@ -148,12 +161,19 @@ public:
 
 Device::Device(const Options& opts)
   : PacketHandler(opts.face, 192)
-  , m_pending(this) {}
+  , m_pending(this)
+  , m_certPending(this)
+  , m_ecpMaxOps(opts.ecpMaxOps)
+  , m_spake2Arena(opts.spake2Arena)
+  , m_ignoreBadPakeRequest(opts.ignoreBadPakeRequest) {
+  m_pakeLimiter.reset(opts.pakeBurst, opts.pakeIntervalMs);
+}
 
 void
 Device::end() {
   finishSession();
   m_state = State::Idle;
+  m_responses.clear();
   m_oRegion.reset();
 }
 
@@ -170,8 +190,34 @@ Device::begin(ndnph::tlv::Value password) {
   }
   std::copy(password.begin(), password.end(), passwordCopy);
   m_password = ndnph::tlv::Value(passwordCopy, password.size());
+  return beginPake();
+}
+
+bool
+Device::begin(const Spake2DeviceVerifier& verifier) {
+  end();
+  m_iRegion.reset(new decltype(m_iRegion)::element_type);
+  m_oRegion.reset(new decltype(m_oRegion)::element_type);
+
+  m_password = ndnph::tlv::Value();
+  if (!m_verifier.assign(verifier)) {
+    end();
+    return false;
+  }
+  return beginPake();
+}
+
+bool
+Device::beginPake() {
+  if (!getRandom().seed()) {
+    end();
+    return false;
+  }
 
-  m_spake2.reset(new Spake2Device(entropy));
+  std::fill_n(m_counters, 3, RetxCounters());
+  m_spake2 = getSpake2Pool().acquire();
+  m_spake2->setMaxOps(m_ecpMaxOps);
+  m_spake2->setArena(m_spake2Arena);
   m_state = State::WaitPakeRequest;
   return true;
 }
@@ -179,22 +225,38 @@ Device::begin(ndnph::tlv::Value password) {
 void
 Device::loop() {
   switch (m_state) {
-    case State::FetchCaProfile: {
-      sendFetchInterest(m_caProfileName, State::WaitCaProfile);
+    case State::ComputePakeShare:
+    case State::ComputePakeKey: {
+      computePake();
       break;
     }
-    case State::FetchAuthenticatorCert: {
-      sendFetchInterest(m_authenticatorCertName, State::WaitAuthenticatorCert);
+    case State::FetchCaProfileAndCert: {
+      // both names are known, so that both packets are fetched in one round trip
+      GotoState gotoState(this);
+      sendFetchInterest(m_pending, m_retx, Fetch::CaProfile, m_caProfileName) &&
+        sendFetchInterest(m_certPending, m_certRetx, Fetch::AuthenticatorCert,
+                          m_authenticatorCertName) &&
+        gotoState(State::WaitCaProfileAndCert);
       break;
     }
     case State::FetchTempCert: {
-      sendFetchInterest(m_tempCertName, State::WaitTempCert);
+      GotoState gotoState(this);
+      sendFetchInterest(m_pending, m_retx, Fetch::TempCert, m_tempCertName) &&
+        gotoState(State::WaitTempCert);
+      break;
+    }
+    case State::WaitCaProfileAndCert: {
+      retxFetchInterest(m_pending, m_retx);
+      retxFetchInterest(m_certPending, m_certRetx);
       break;
     }
-    case State::WaitCaProfile:
-    case State::WaitAuthenticatorCert:
     case State::WaitTempCert: {
-      if (m_pending.expired()) {
+      retxFetchInterest(m_pending, m_retx);
+      break;
+    }
+    case State::WaitConfirmRequest:
+    case State::WaitCredentialRequest: {
+      if (m_retx.isExpired()) {
         m_state = State::Failure;
       }
       break;
@@ -206,6 +268,10 @@ Device::loop() {
 
 bool
 Device::processInterest(ndnph::Interest interest) {
+  if (replayResponse(interest)) {
+    return true;
+  }
+
   switch (m_state) {
     case State::WaitPakeRequest: {
       return handlePakeRequest(interest);
@@ -226,8 +292,7 @@ bool
 Device::checkInterestVerb(ndnph::Interest interest, const ndnph::Component& expectedVerb) {
   const auto& name = interest.getName();
   return name.size() == getPionPrefix().size() + 3 && getPionPrefix().isPrefixOf(name) &&
-         name[-2] == expectedVerb && interest.checkDigest() &&
-         m_session.assign(*m_iRegion, interest.getName());
+         name[-2] == expectedVerb && interest.checkDigest();
 }
 
 void
@@ -236,35 +301,134 @@ Device::saveCurrentInterest(ndnph::Interest interest) {
   m_lastInterestPacketInfo = *getCurrentPacketInfo();
 }
 
+bool
+Device::replayResponse(ndnph::Interest interest) {
+  auto wire = m_responses.find(interest.getName());
+  if (wire.size() == 0) {
+    return false;
+  }
+
+  ndnph::StaticRegion<2048> region;
+  auto data = region.create<ndnph::Data>();
+  return !!data && wire.makeDecoder().decode(data) && send(data, *getCurrentPacketInfo());
+}
+
+bool
+Device::sendResponse(ndnph::Region& region, const ndnph::Data::Signed& data) {
+  if (!data) {
+    return false;
+  }
+
+  // encode once, so that the signature is computed once and the cached reply is identical
+  ndnph::Encoder encoder(region);
+  encoder.prepend(data);
+  if (!encoder) {
+    encoder.discard();
+    return false;
+  }
+  encoder.trim();
+  ndnph::tlv::Value wire(encoder);
+
+  auto decoded = region.create<ndnph::Data>();
+  if (!decoded || !wire.makeDecoder().decode(decoded)) {
+    return false;
+  }
+  m_responses.save(m_lastInterestName, wire);
+  return send(decoded, m_lastInterestPacketInfo);
+}
+
 bool
 Device::handlePakeRequest(ndnph::Interest interest) {
   if (!checkInterestVerb(interest, getPakeComponent())) {
     return false;
   }
 
+  // validate in order of increasing cost, before committing to this request
   ndnph::StaticRegion<2048> region;
-  GotoState gotoState(this);
   PakeRequest req;
-  PakeResponse res;
-  bool ok =
-    req.fromInterest(region, interest) &&
-    m_spake2->start(m_password.begin(), m_password.size(), nullptr, 0,
-                    req.authenticatorCertName[-1].value(), req.authenticatorCertName[-1].length(),
-                    m_session.ss.value(), m_session.ss.length()) &&
-    m_spake2->generateFirstMessage(res.spake2pb, sizeof(res.spake2pb)) &&
-    m_spake2->processFirstMessage(req.spake2pa, sizeof(req.spake2pa)) &&
-    m_spake2->generateSecondMessage(res.spake2cb, sizeof(res.spake2cb)) &&
-    reply(res.toData(region, interest)) && gotoState(State::WaitConfirmRequest);
-
-  if (ok) {
-    m_authenticatorCertName = req.authenticatorCertName.clone(*m_iRegion);
+  bool ok = req.fromInterest(region, interest) &&
+            Spake2Device::checkFirstMessage(req.spake2pa, req.spake2paLen);
+  if (!ok && m_ignoreBadPakeRequest) {
+    return true;
   }
-  return true;
+  if (ok && !m_pakeLimiter.take()) {
+    // over the rate limit: drop the request and keep waiting
+    return true;
+  }
+
+  GotoState gotoState(this);
+  ok = ok && m_session.assign(*m_iRegion, interest.getName());
+  if (ok && m_verifier.isValid()) {
+    ok = m_spake2->start(m_verifier, nullptr, 0, req.authenticatorCertName[-1].value(),
+                         req.authenticatorCertName[-1].length(), m_session.ss.value(),
+                         m_session.ss.length());
+  } else if (ok) {
+    ok = m_spake2->start(m_password.begin(), m_password.size(), nullptr, 0,
+                         req.authenticatorCertName[-1].value(),
+                         req.authenticatorCertName[-1].length(), m_session.ss.value(),
+                         m_session.ss.length());
+  }
+  if (!ok) {
+    return true;
+  }
+
+  // the response is sent by computePake() after the SPAKE2 computations
+  m_retx.begin();
+  m_certRetx.begin();
+  saveCurrentInterest(interest);
+  m_authenticatorCertName = req.authenticatorCertName.clone(*m_iRegion);
+  // the response uses the same point format as the request
+  m_spake2paLen = req.spake2paLen;
+  std::copy_n(req.spake2pa, m_spake2paLen, m_spake2pa);
+  return gotoState(State::ComputePakeShare);
+}
+
+void
+Device::computePake() {
+  GotoState gotoState(this);
+  spake2::Progress progress = spake2::Progress::Failure;
+  switch (m_state) {
+    case State::ComputePakeShare: {
+      progress = m_spake2->generateFirstMessageStep(m_spake2pb, m_spake2paLen);
+      if (progress == spake2::Progress::Complete) {
+        gotoState(State::ComputePakeKey);
+        return;
+      }
+      break;
+    }
+    case State::ComputePakeKey: {
+      progress = m_spake2->processFirstMessageStep(m_spake2pa, m_spake2paLen);
+      break;
+    }
+    default:
+      break;
+  }
+
+  switch (progress) {
+    case spake2::Progress::InProgress: {
+      gotoState(m_state);
+      return;
+    }
+    case spake2::Progress::Complete: {
+      break;
+    }
+    default:
+      return;
+  }
+
+  ndnph::StaticRegion<2048> region;
+  PakeResponse res;
+  res.spake2pbLen = m_spake2paLen;
+  std::copy_n(m_spake2pb, res.spake2pbLen, res.spake2pb);
+  m_spake2->generateSecondMessage(res.spake2cb, sizeof(res.spake2cb)) &&
+    sendResponse(region, res.toData(region, m_lastInterestName)) &&
+    gotoState(State::WaitConfirmRequest);
 }
 
 bool
 Device::handleConfirmRequest(ndnph::Interest interest) {
-  if (!checkInterestVerb(interest, getConfirmComponent())) {
+  if (!checkInterestVerb(interest, getConfirmComponent()) ||
+      !m_session.assign(*m_iRegion, interest.getName())) {
     return false;
   }
 
@@ -291,12 +455,13 @@ Device::handleConfirmRequest(ndnph::Interest interest) {
   m_caProfileName = req.caProfileName.clone(*m_iRegion);
   m_deviceName = req.deviceName.clone(*m_oRegion);
 
-  return gotoState(State::FetchCaProfile);
+  return gotoState(State::FetchCaProfileAndCert);
 }
 
 bool
 Device::handleCredentialRequest(ndnph::Interest interest) {
-  if (!checkInterestVerb(interest, getCredentialComponent())) {
+  if (!checkInterestVerb(interest, getCredentialComponent()) ||
+      !m_session.assign(*m_iRegion, interest.getName())) {
     return false;
   }
 
@@ -312,31 +477,42 @@ Device::handleCredentialRequest(ndnph::Interest interest) {
   return gotoState(State::FetchTempCert);
 }
 
+bool
+Device::sendFetchInterest(OutgoingPendingInterest& pending, Retransmitter& retx, Fetch type,
+                          const ndnph::Name& name) {
+  retx.save(name, ndnph::tlv::Value(), m_counters[static_cast<int>(type)]);
+  return retx.transmit(pending, WithEndpointId(m_lastInterestPacketInfo.endpointId));
+}
+
 void
-Device::sendFetchInterest(const ndnph::Name& name, State nextState) {
-  ndnph::StaticRegion<2048> region;
-  GotoState gotoState(this);
-  auto interest = region.create<ndnph::Interest>();
-  if (!interest) {
-    return;
+Device::retxFetchInterest(OutgoingPendingInterest& pending, Retransmitter& retx) {
+  switch (retx.poll()) {
+    case Retransmitter::Action::Retransmit: {
+      if (!retx.transmit(pending, WithEndpointId(m_lastInterestPacketInfo.endpointId))) {
+        m_state = State::Failure;
+      }
+      break;
+    }
+    case Retransmitter::Action::Expired: {
+      m_state = State::Failure;
+      break;
+    }
+    default:
+      break;
   }
-  interest.setName(name);
-  interest.setLifetime(InterestLifetime::value);
-  m_pending.send(interest, WithEndpointId(m_lastInterestPacketInfo.endpointId)) &&
-    gotoState(nextState);
+}
+
+bool
+Device::isReplyTo(OutgoingPendingInterest& pending, const Retransmitter& retx) {
+  // after a retransmission, a reply to an earlier transmission carries an older PIT token
+  return retx.isPending() && (pending.matchPitToken() || retx.hasRetransmitted());
 }
 
 bool
 Device::processData(ndnph::Data data) {
-  if (!m_pending.matchPitToken()) {
-    return false;
-  }
   switch (m_state) {
-    case State::WaitCaProfile: {
-      return handleCaProfile(data);
-    }
-    case State::WaitAuthenticatorCert: {
-      return handleAuthenticatorCert(data);
+    case State::WaitCaProfileAndCert: {
+      return handleCaProfile(data) || handleAuthenticatorCert(data);
     }
     case State::WaitTempCert: {
       return handleTempCert(data);
@@ -349,49 +525,71 @@ Device::processData(ndnph::Data data) {
 
 bool
 Device::handleCaProfile(ndnph::Data data) {
-  if (!m_pending.match(data, m_caProfileName) || !m_caProfile.fromData(*m_oRegion, data)) {
+  if (!isReplyTo(m_pending, m_retx) || !m_pending.match(data, m_caProfileName) ||
+      !m_caProfile.fromData(*m_oRegion, data)) {
+    return false;
+  }
+  m_retx.satisfy();
+
+  sendConfirmResponse();
+  return true;
+}
+
+bool
+Device::handleAuthenticatorCert(ndnph::Data data) {
+  if (!isReplyTo(m_certPending, m_certRetx) ||
+      !m_certPending.match(data, m_authenticatorCertName)) {
     return false;
   }
+  m_certRetx.satisfy();
 
+  // the certificate is kept until the CA profile, which has the key to verify it, arrives
   GotoState gotoState(this);
-  if (!ndnph::certificate::getValidity(m_caProfile.cert).includes(time(nullptr))) {
-    // CA certificate expired
+  m_authenticatorCert = m_iRegion->create<ndnph::Data>();
+  if (!m_authenticatorCert || !m_authenticatorCert.decodeFrom(data)) {
     return true;
   }
+  gotoState(m_state);
 
-  gotoState(State::FetchAuthenticatorCert);
+  sendConfirmResponse();
   return true;
 }
 
-bool
-Device::handleAuthenticatorCert(ndnph::Data data) {
-  if (!m_pending.match(data, m_authenticatorCertName)) {
-    return false;
+void
+Device::sendConfirmResponse() {
+  if (m_retx.isPending() || m_certRetx.isPending()) {
+    // waiting for the other packet
+    return;
   }
 
   ndnph::StaticRegion<2048> region;
   GotoState gotoState(this);
-  if (!data.verify(m_caProfile.pub) || !ndnph::certificate::getValidity(data).includesUnix()) {
-    return false;
+  if (!ndnph::certificate::getValidity(m_caProfile.cert).includes(time(nullptr))) {
+    // CA certificate expired
+    return;
+  }
+
+  const ndnph::Data& cert = m_authenticatorCert;
+  if (!cert.verify(m_caProfile.pub) || !ndnph::certificate::getValidity(cert).includesUnix()) {
+    return;
   }
 
-  ndnph::Name tSubject = computeTempSubjectName(region, data.getName(), m_deviceName);
+  ndnph::Name tSubject = computeTempSubjectName(region, cert.getName(), m_deviceName);
   if (!tSubject || !ndnph::ec::generate(*m_oRegion, tSubject, m_tPvt, m_tPub)) {
-    return true;
+    return;
   }
 
   auto tCert = m_tPub.selfSign(region, ndnph::ValidityPeriod::getMax(), m_tPvt);
-  send(makeConfirmResponseData(region, m_lastInterestName, m_session, tCert),
-       m_lastInterestPacketInfo) &&
+  sendResponse(region, makeConfirmResponseData(region, m_lastInterestName, m_session, tCert)) &&
     gotoState(State::WaitCredentialRequest);
-  return true;
 }
 
 bool
 Device::handleTempCert(ndnph::Data data) {
-  if (!m_pending.match(data, m_tempCertName)) {
+  if (!isReplyTo(m_pending, m_retx) || !m_pending.match(data, m_tempCertName)) {
     return false;
   }
+  m_retx.satisfy();
 
   GotoState gotoState(this);
   ndnph::StaticRegion<2048> region;
@@ -404,13 +602,17 @@ Device::handleTempCert(ndnph::Data data) {
   m_tPvt.setName(m_tempCert.getName());
 
   res.setName(m_lastInterestName);
-  send(res.sign(m_tPvt), m_lastInterestPacketInfo) && gotoState(State::Success);
+  sendResponse(region, res.sign(m_tPvt)) && gotoState(State::Success);
   return true;
 }
 
 void
 Device::finishSession() {
+  m_retx.end();
+  m_certRetx.end();
+  m_authenticatorCert = ndnph::Data();
   m_session.end();
+  m_verifier.clear();
   m_spake2.reset();
   m_iRegion.reset();
 }
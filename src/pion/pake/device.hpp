@@ -6,28 +6,86 @@
 namespace pion {
 namespace pake {
 
-/** @brief PION Onboarding Protocol - PAKE stage, device side. */
+/**
+ * @brief PION Onboarding Protocol - PAKE stage, device side.
+ *
+ * The time limit of the procedure, ProtocolTimeLimit, starts when a PAKE request is accepted.
+ * Fetch Interests that are not answered within the retransmission timeout are retransmitted.
+ * Retransmitted command Interests from the authenticator are answered from a response cache,
+ * which is kept until end() so that the acknowledgement can be resent after Success.
+ */
 class Device : public ndnph::PacketHandler {
 public:
   struct Options {
     /** @brief Face for communication. */
     ndnph::Face& face;
+
+    /**
+     * @brief Maximum number of basic EC operations per loop() iteration.
+     *
+     * SPAKE2 computations are spread over several loop() iterations, so that other work can run
+     * in between. 0 means at most one scalar multiplication per iteration.
+     * @sa spake2::Context::setMaxOps()
+     */
+    unsigned ecpMaxOps;
+
+    /**
+     * @brief Arena for the bignum allocations of SPAKE2, or nullptr to use the heap.
+     * @sa spake2::Context::setArena()
+     */
+    spake2::Arena* spake2Arena;
+
+    /**
+     * @brief Maximum number of PAKE requests accepted in a burst; 0 disables the limiter.
+     *
+     * Each accepted PAKE request costs two scalar multiplications. Requests over the limit are
+     * dropped before any of them, and the device keeps waiting.
+     *
+     * The bucket is filled by the constructor and spans begin() calls, while each begin() accepts
+     * at most one request. Hence it only limits repeated attempts if the same Device is begun
+     * again after a failure, instead of a new Device being constructed for each attempt.
+     */
+    uint16_t pakeBurst;
+
+    /** @brief Interval in milliseconds at which the PAKE request limiter earns one request. */
+    uint32_t pakeIntervalMs;
+
+    /**
+     * @brief Whether to keep waiting after a malformed PAKE request, instead of failing.
+     *
+     * A PAKE request is malformed if its parameters cannot be decoded, or if its SPAKE2 share is
+     * not a valid point. Without this option, anyone can abort an onboarding with one Interest.
+     */
+    bool ignoreBadPakeRequest;
   };
 
   explicit Device(const Options& opts);
 
   void end();
 
+  /**
+   * @brief Start waiting for an authenticator, with a password.
+   * @return whether success; false if the DRBG cannot be seeded from the entropy source.
+   */
   bool begin(ndnph::tlv::Value password);
 
+  /**
+   * @brief Start waiting for an authenticator, with a precomputed password verifier.
+   *
+   * This suits a password assigned in the factory. The verifier is copied; if it includes w*N,
+   * computing the SPAKE2 share costs one scalar multiplication instead of two.
+   * @return whether success; false if the DRBG cannot be seeded from the entropy source.
+   */
+  bool begin(const Spake2DeviceVerifier& verifier);
+
   enum class State {
     Idle,
     WaitPakeRequest,
+    ComputePakeShare,
+    ComputePakeKey,
     WaitConfirmRequest,
-    FetchCaProfile,
-    WaitCaProfile,
-    FetchAuthenticatorCert,
-    WaitAuthenticatorCert,
+    FetchCaProfileAndCert,
+    WaitCaProfileAndCert,
     WaitCredentialRequest,
     FetchTempCert,
     WaitTempCert,
@@ -64,22 +122,55 @@ public:
     return m_tPvt;
   }
 
+  /** @brief Interest sent by the device. */
+  enum class Fetch {
+    CaProfile,
+    AuthenticatorCert,
+    TempCert,
+  };
+
+  /** @brief Return retransmission and latency counters of a type of Interest. */
+  const RetxCounters& getCounters(Fetch type) const {
+    return m_counters[static_cast<int>(type)];
+  }
+
+  /** @brief Return smoothed RTT in milliseconds, or -1 if there is no sample. */
+  int getSrtt() const {
+    return m_retx.getSrtt();
+  }
+
 private:
   void loop() final;
 
   bool processInterest(ndnph::Interest interest) final;
 
+  /** @brief Check the name and digest of a command Interest, without touching the session. */
   bool checkInterestVerb(ndnph::Interest interest, const ndnph::Component& expectedVerb);
 
   void saveCurrentInterest(ndnph::Interest interest);
 
+  /** @brief Reply to a retransmitted Interest from the response cache. */
+  bool replayResponse(ndnph::Interest interest);
+
+  /** @brief Reply to the current Interest, and save the reply in the response cache. */
+  bool sendResponse(ndnph::Region& region, const ndnph::Data::Signed& data);
+
   bool handlePakeRequest(ndnph::Interest interest);
 
+  void computePake();
+
   bool handleConfirmRequest(ndnph::Interest interest);
 
   bool handleCredentialRequest(ndnph::Interest interest);
 
-  void sendFetchInterest(const ndnph::Name& name, State nextState);
+  bool sendFetchInterest(OutgoingPendingInterest& pending, Retransmitter& retx, Fetch type,
+                         const ndnph::Name& name);
+
+  /** @brief Retransmit a fetch Interest if needed; fail at the end of the time limit. */
+  void retxFetchInterest(OutgoingPendingInterest& pending, Retransmitter& retx);
+
+  /** @brief Determine whether the current Data may answer an outstanding fetch Interest. */
+  static bool isReplyTo(OutgoingPendingInterest& pending, const Retransmitter& retx);
 
   bool processData(ndnph::Data data) final;
 
@@ -87,8 +178,18 @@ private:
 
   bool handleAuthenticatorCert(ndnph::Data data);
 
+  /**
+   * @brief Reply to the confirm request, once the CA profile and authenticator certificate arrive.
+   *
+   * The authenticator certificate is verified with the key in the CA profile.
+   */
+  void sendConfirmResponse();
+
   bool handleTempCert(ndnph::Data data);
 
+  /** @brief Seed the DRBG, acquire the SPAKE2 context, and start waiting for PAKE request. */
+  bool beginPake();
+
   void finishSession();
 
 private:
@@ -98,18 +199,32 @@ private:
   class ConfirmRequest;
   class CredentialRequest;
 
-  OutgoingPendingInterest m_pending;
+  OutgoingPendingInterest m_pending;     // CA profile, then temp cert
+  Retransmitter m_retx;                  // for m_pending
+  OutgoingPendingInterest m_certPending; // authenticator cert, alongside the CA profile
+  Retransmitter m_certRetx;              // for m_certPending
+  RetxCounters m_counters[3];
   State m_state = State::Idle;
   std::unique_ptr<ndnph::StaticRegion<2048>> m_iRegion; // for intermediate values
   std::unique_ptr<ndnph::StaticRegion<2048>> m_oRegion; // for output values
 
   ndnph::tlv::Value m_password;
+  Spake2DeviceVerifier m_verifier; // used instead of m_password if valid
   EncryptSession m_session;
-  std::unique_ptr<Spake2Device> m_spake2;
+  Spake2DevicePool::Ptr m_spake2;
+  unsigned m_ecpMaxOps = 0;
+  spake2::Arena* m_spake2Arena = nullptr;
+  TokenBucket m_pakeLimiter;
+  bool m_ignoreBadPakeRequest = false;
+  uint8_t m_spake2pa[Spake2Device::FirstMessageSize];
+  size_t m_spake2paLen = 0;
+  uint8_t m_spake2pb[Spake2Device::FirstMessageSize];
 
   ndnph::Name m_lastInterestName;
   PacketInfo m_lastInterestPacketInfo;
+  ResponseCache m_responses; // kept after Success for retransmissions of the last Interest
   ndnph::Name m_authenticatorCertName;
+  ndnph::Data m_authenticatorCert; // in m_iRegion, until the CA profile arrives
   ndnph::Name m_caProfileName;
   ndnph::Name m_tempCertName;
 
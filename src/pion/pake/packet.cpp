@@ -1,7 +1,45 @@
 #include "packet.hpp"
 
+#include <mbedtls/gcm.h>
+
 namespace pion {
 namespace pake {
+namespace {
+
+/** @brief AES-GCM test case 2 of the GCM specification: zero key, IV, and plaintext. */
+bool
+checkAesGcm() {
+  static const uint8_t zero[16]{};
+  static const uint8_t ciphertext[16]{
+    0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78,
+  };
+  static const uint8_t tag[16]{
+    0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd, 0xf5, 0x3a, 0x67, 0xb2, 0x12, 0x57, 0xbd, 0xdf,
+  };
+
+  mbedtls_gcm_context ctx;
+  mbedtls_gcm_init(&ctx);
+  uint8_t out[16];
+  uint8_t outTag[16];
+  uint8_t badTag[16];
+  std::copy_n(tag, sizeof(tag), badTag);
+  badTag[15] ^= 0x01;
+  bool ok =
+    mbedtls_gcm_setkey(&ctx, MBEDTLS_CIPHER_ID_AES, zero, 128) == 0 &&
+    mbedtls_gcm_crypt_and_tag(&ctx, MBEDTLS_GCM_ENCRYPT, sizeof(zero), zero, 12, nullptr, 0, zero,
+                              out, sizeof(outTag), outTag) == 0 &&
+    std::equal(out, out + sizeof(out), ciphertext) &&
+    std::equal(outTag, outTag + sizeof(outTag), tag) &&
+    mbedtls_gcm_auth_decrypt(&ctx, sizeof(ciphertext), zero, 12, nullptr, 0, tag, sizeof(tag),
+                             ciphertext, out) == 0 &&
+    std::equal(out, out + sizeof(out), zero) &&
+    mbedtls_gcm_auth_decrypt(&ctx, sizeof(ciphertext), zero, 12, nullptr, 0, badTag,
+                             sizeof(badTag), ciphertext, out) == MBEDTLS_ERR_GCM_AUTH_FAILED;
+  mbedtls_gcm_free(&ctx);
+  return ok;
+}
+
+} // namespace
 
 void
 EncryptSession::end() {
@@ -10,9 +48,9 @@ EncryptSession::end() {
 }
 
 bool
-EncryptSession::begin(ndnph::Region& region) {
+EncryptSession::begin(ndnph::Region& region, spake2::Random& random) {
   uint8_t value[8];
-  if (!ndnph::port::RandomSource::generate(value, sizeof(value))) {
+  if (!random.generate(value, sizeof(value))) {
     return false;
   }
   ss = ndnph::Component(region, sizeof(value), value);
@@ -32,11 +70,187 @@ EncryptSession::makeName(ndnph::Region& region, const ndnph::Component& verb) {
   return getPionPrefix().append(region, ss, verb);
 }
 
+bool
+EncryptSession::selfTest() {
+  static const bool ok = checkAesGcm();
+  return ok;
+}
+
 ndnph::tlv::Value
 EncryptSession::decrypt(ndnph::Region& region, const Encrypted& encrypted) {
   return aes->decrypt(region, encrypted, ss.value(), ss.length());
 }
 
+void
+TokenBucket::reset(uint16_t burst, uint32_t intervalMs) {
+  m_last = ndnph::port::Clock::now();
+  m_intervalMs = std::max<uint32_t>(intervalMs, 1);
+  m_burst = burst;
+  m_tokens = burst;
+}
+
+bool
+TokenBucket::take() {
+  if (m_burst == 0) {
+    return true;
+  }
+
+  auto now = ndnph::port::Clock::now();
+  int elapsed = ndnph::port::Clock::sub(now, m_last);
+  if (elapsed < 0) {
+    m_last = now;
+  } else if (static_cast<uint32_t>(elapsed) >= m_intervalMs) {
+    uint32_t earned = static_cast<uint32_t>(elapsed) / m_intervalMs;
+    if (earned >= static_cast<uint32_t>(m_burst - m_tokens)) {
+      m_tokens = m_burst;
+      m_last = now;
+    } else {
+      m_tokens = static_cast<uint16_t>(m_tokens + earned);
+      m_last = ndnph::port::Clock::add(m_last, static_cast<int>(earned * m_intervalMs));
+    }
+  }
+
+  if (m_tokens == 0) {
+    return false;
+  }
+  --m_tokens;
+  return true;
+}
+
+void
+Retransmitter::begin(int timeLimit) {
+  end();
+  m_end = ndnph::port::Clock::add(ndnph::port::Clock::now(), timeLimit);
+  m_srtt = -1;
+  m_rttvar = 0;
+  m_rto = InitialRto;
+}
+
+void
+Retransmitter::end() {
+  m_buffer.reset();
+  m_name = ndnph::Name();
+  m_params = ndnph::tlv::Value();
+  m_counters = nullptr;
+  m_nRetx = 0;
+}
+
+void
+Retransmitter::save(const ndnph::Name& name, ndnph::tlv::Value params, RetxCounters& counters) {
+  size_t size = name.length() + params.size();
+  m_buffer.reset(new uint8_t[size]);
+  uint8_t* p = std::copy_n(name.value(), name.length(), m_buffer.get());
+  std::copy(params.begin(), params.end(), p);
+  m_name = ndnph::Name(m_buffer.get(), name.length());
+  m_params = ndnph::tlv::Value(p, params.size());
+
+  m_counters = &counters;
+  ++counters.nInterests;
+  m_nRetx = 0;
+  m_firstSent = m_lastSent = ndnph::port::Clock::now();
+}
+
+bool
+Retransmitter::matchName(const ndnph::Name& name) const {
+  if (!isPending()) {
+    return false;
+  }
+  if (m_params.size() == 0) {
+    return name == m_name;
+  }
+  return name.size() == m_name.size() + 1 && m_name.isPrefixOf(name) &&
+         name[-1].type() == ndnph::TT::ParametersSha256DigestComponent;
+}
+
+bool
+Retransmitter::isExpired() const {
+  return ndnph::port::Clock::sub(ndnph::port::Clock::now(), m_end) >= 0;
+}
+
+Retransmitter::Action
+Retransmitter::poll() {
+  if (isExpired()) {
+    return Action::Expired;
+  }
+  if (!isPending()) {
+    return Action::None;
+  }
+
+  auto now = ndnph::port::Clock::now();
+  if (ndnph::port::Clock::sub(now, m_lastSent) < m_rto) {
+    return Action::None;
+  }
+
+  // exponential backoff, as in RFC 6298 section 5.5
+  m_rto = std::min<int>(m_rto * 2, MaxRto);
+  m_lastSent = now;
+  ++m_nRetx;
+  ++m_counters->nRetx;
+  return Action::Retransmit;
+}
+
+void
+Retransmitter::satisfy() {
+  if (!isPending()) {
+    return;
+  }
+
+  auto now = ndnph::port::Clock::now();
+  auto latency = static_cast<uint32_t>(std::max(ndnph::port::Clock::sub(now, m_firstSent), 0));
+  ++m_counters->nData;
+  m_counters->latencySum += latency;
+  m_counters->latencyMax = std::max(m_counters->latencyMax, latency);
+
+  // Karn's algorithm: the RTT of a retransmitted Interest is ambiguous
+  if (m_nRetx == 0) {
+    addRttSample(static_cast<int>(latency));
+  }
+  end();
+}
+
+void
+Retransmitter::addRttSample(int rtt) {
+  // RFC 6298 section 2, with alpha=1/8 and beta=1/4
+  if (m_srtt < 0) {
+    m_srtt = rtt;
+    m_rttvar = rtt / 2;
+  } else {
+    m_rttvar = (3 * m_rttvar + std::abs(m_srtt - rtt)) / 4;
+    m_srtt = (7 * m_srtt + rtt) / 8;
+  }
+  m_rto = std::min<int>(std::max<int>(m_srtt + std::max(1, 4 * m_rttvar), MinRto), MaxRto);
+}
+
+void
+ResponseCache::clear() {
+  for (Entry& entry : m_entries) {
+    entry = Entry();
+  }
+  m_next = 0;
+}
+
+void
+ResponseCache::save(const ndnph::Name& interestName, ndnph::tlv::Value wire) {
+  Entry& entry = m_entries[m_next];
+  m_next = (m_next + 1) % Capacity;
+
+  entry.buffer.reset(new uint8_t[interestName.length() + wire.size()]);
+  uint8_t* p = std::copy_n(interestName.value(), interestName.length(), entry.buffer.get());
+  std::copy(wire.begin(), wire.end(), p);
+  entry.name = ndnph::Name(entry.buffer.get(), interestName.length());
+  entry.wire = ndnph::tlv::Value(p, wire.size());
+}
+
+ndnph::tlv::Value
+ResponseCache::find(const ndnph::Name& interestName) const {
+  for (const Entry& entry : m_entries) {
+    if (entry.buffer != nullptr && entry.name == interestName) {
+      return entry.wire;
+    }
+  }
+  return ndnph::tlv::Value();
+}
+
 ndnph::Name
 computeTempSubjectName(ndnph::Region& region, ndnph::Name authenticatorCertName,
                        ndnph::Name deviceName) {
@@ -1,14 +1,43 @@
 #ifndef PION_PAKE_PACKET_HPP
 #define PION_PAKE_PACKET_HPP
 
+#include "../spake2/pool.hpp"
 #include "../spake2/spake2.hpp"
 #include "an.hpp"
 
 namespace pion {
 namespace pake {
 
-using Spake2Authenticator = spake2::Context<spake2::Role::Alice>;
-using Spake2Device = spake2::Context<spake2::Role::Bob>;
+/**
+ * @brief SPAKE2 group of the onboarding protocol.
+ *
+ * Define PION_SPAKE2_EDWARDS25519 to select edwards25519 instead of P-256.
+ * Both the authenticator and the device must be built with the same group.
+ */
+#ifdef PION_SPAKE2_EDWARDS25519
+using Spake2Group = spake2::Edwards25519;
+#else
+using Spake2Group = spake2::P256;
+#endif
+
+using Spake2Authenticator = spake2::Context<spake2::Role::Alice, Spake2Group>;
+using Spake2Device = spake2::Context<spake2::Role::Bob, Spake2Group>;
+
+/** @brief Pool of warm SPAKE2 contexts, shared by Authenticator instances. */
+using Spake2AuthenticatorPool = spake2::ContextPool<Spake2Authenticator, 4>;
+
+/** @brief Pool of precomputed SPAKE2 ephemeral shares, shared by Authenticator instances. */
+using Spake2EphemeralPool = spake2::EphemeralPool<Spake2Group, 4>;
+
+/** @brief Pool of warm SPAKE2 contexts, shared by Device instances. */
+using Spake2DevicePool = spake2::ContextPool<Spake2Device, 1>;
+
+/**
+ * @brief Precomputed password verifier for Device::begin().
+ *
+ * Include WithN, which is the point used by the device, to save a scalar multiplication.
+ */
+using Spake2DeviceVerifier = spake2::Verifier<Spake2Group>;
 
 namespace packet_struct {
 
@@ -29,6 +58,8 @@ namespace packet_struct {
 
 struct PakeRequest {
   uint8_t spake2pa[Spake2Device::FirstMessageSize];
+  /** @brief Length of spake2pa; CompressedFirstMessageSize indicates a compressed point. */
+  size_t spake2paLen = sizeof(spake2pa);
   ndnph::Name authenticatorCertName;
 
 #ifdef NDNPH_PRINT_OSTREAM
@@ -43,6 +74,8 @@ struct PakeRequest {
 
 struct PakeResponse {
   uint8_t spake2pb[Spake2Device::FirstMessageSize];
+  /** @brief Length of spake2pb; CompressedFirstMessageSize indicates a compressed point. */
+  size_t spake2pbLen = sizeof(spake2pb);
   uint8_t spake2cb[Spake2Device::SecondMessageSize];
 
 #ifdef NDNPH_PRINT_OSTREAM
@@ -127,9 +160,10 @@ public:
 
   /**
    * @brief Create new session ID.
+   * @param random DRBG of the current thread.
    * @return whether success.
    */
-  bool begin(ndnph::Region& region);
+  bool begin(ndnph::Region& region, spake2::Random& random);
 
   /**
    * @brief Assign session ID unless it's already assigned.
@@ -140,11 +174,23 @@ public:
   /** @brief Construct Interest name. */
   ndnph::Name makeName(ndnph::Region& region, const ndnph::Component& verb);
 
+  /**
+   * @brief Check AES-GCM against a known answer.
+   * @return whether AES-GCM produced the expected ciphertext and tag, and rejected a bad tag.
+   *
+   * mbedtls selects AES-NI and PCLMULQDQ at runtime when it is built with MBEDTLS_AESNI_C, so that
+   * the implementation may differ between hosts. The check runs once per process.
+   */
+  static bool selfTest();
+
   /**
    * @brief Import AES-GCM key.
-   * @return whether success.
+   * @return whether success; false if selfTest() fails.
    */
   bool importKey(const AesGcm::Key& key) {
+    if (!selfTest()) {
+      return false;
+    }
     aes.reset(new AesGcm());
     return aes->import(key);
   }
@@ -170,6 +216,68 @@ public:
   std::unique_ptr<AesGcm> aes;
 };
 
+/** @brief Token bucket that limits the rate of expensive operations. */
+class TokenBucket {
+public:
+  /**
+   * @brief Set the limits and fill the bucket.
+   * @param burst capacity of the bucket; 0 disables the limiter.
+   * @param intervalMs time to earn one token, in milliseconds.
+   */
+  void reset(uint16_t burst, uint32_t intervalMs);
+
+  /**
+   * @brief Take a token.
+   * @return whether a token was available, or the limiter is disabled.
+   */
+  bool take();
+
+private:
+  ndnph::port::Clock::Time m_last{};
+  uint32_t m_intervalMs = 0;
+  uint16_t m_burst = 0;
+  uint16_t m_tokens = 0;
+};
+
+/**
+ * @brief Data sent in reply to command Interests, kept for replying to retransmissions.
+ *
+ * Entries are keyed by the Interest name, which ends with the parameters digest, so that only an
+ * Interest with the same name and AppParameters receives the saved Data. Replaying the saved Data
+ * avoids repeating the cryptographic operations, and the reply is identical to the first one.
+ */
+class ResponseCache {
+public:
+  enum {
+    Capacity = 3,
+  };
+
+  /** @brief Delete all entries. */
+  void clear();
+
+  /**
+   * @brief Save a reply, replacing the oldest entry if the cache is full.
+   * @param interestName full name of the Interest.
+   * @param wire encoded Data.
+   */
+  void save(const ndnph::Name& interestName, ndnph::tlv::Value wire);
+
+  /**
+   * @brief Find the reply to an Interest.
+   * @return encoded Data, or an empty value if not found.
+   */
+  ndnph::tlv::Value find(const ndnph::Name& interestName) const;
+
+private:
+  struct Entry {
+    std::unique_ptr<uint8_t[]> buffer; // name TLV-VALUE followed by Data wire
+    ndnph::Name name;
+    ndnph::tlv::Value wire;
+  };
+  Entry m_entries[Capacity];
+  uint8_t m_next = 0;
+};
+
 ndnph::Name
 computeTempSubjectName(ndnph::Region& region, ndnph::Name authenticatorCertName,
                        ndnph::Name deviceName);
@@ -178,6 +286,131 @@ using TempCertValidity = std::integral_constant<int, 300>;
 
 using InterestLifetime = std::integral_constant<int, 10000>;
 
+/** @brief Time limit of the onboarding procedure, since the first message, in milliseconds. */
+using ProtocolTimeLimit = std::integral_constant<int, 30000>;
+
+/** @brief Counters of one type of outgoing Interest. */
+struct RetxCounters {
+  uint16_t nInterests = 0; ///< Interests sent, excluding retransmissions
+  uint16_t nRetx = 0;      ///< retransmissions
+  uint16_t nData = 0;      ///< Interests satisfied
+  uint32_t latencySum = 0; ///< sum of latency of satisfied Interests, in milliseconds
+  uint32_t latencyMax = 0; ///< maximum latency of satisfied Interests, in milliseconds
+};
+
+/**
+ * @brief Retransmission of the outgoing Interest of a session.
+ *
+ * The Interest is saved as its name and AppParameters, so that a retransmission has the same name
+ * and parameters digest, and only the nonce differs. The retransmission timeout is computed from
+ * SRTT and RTTVAR as in RFC 6298, and doubles on every retransmission. All Interests of a session
+ * share one time limit, ProtocolTimeLimit by default. RTT samples are taken only from Interests
+ * that have not been retransmitted. Latency counters measure from the first transmission.
+ */
+class Retransmitter {
+public:
+  enum {
+    InitialRto = 1000,
+    MinRto = 200,
+    MaxRto = InterestLifetime::value,
+  };
+
+  enum class Action {
+    None,       ///< nothing to do
+    Retransmit, ///< the Interest should be retransmitted with transmit()
+    Expired,    ///< time limit reached
+  };
+
+  /** @brief Reset the estimator and start the time limit. */
+  void begin(int timeLimit = ProtocolTimeLimit::value);
+
+  /** @brief Forget the outgoing Interest. */
+  void end();
+
+  /**
+   * @brief Save an outgoing Interest.
+   * @param name Interest name, excluding ParametersSha256DigestComponent.
+   * @param params AppParameters, or an empty value for an Interest without AppParameters.
+   * @param counters counters of this type of Interest; must outlive the Interest.
+   * @post call transmit() to send it.
+   */
+  void save(const ndnph::Name& name, ndnph::tlv::Value params, RetxCounters& counters);
+
+  /**
+   * @brief Send the saved Interest.
+   * @tparam Pending @c ndnph::PacketHandler::OutgoingPendingInterest .
+   * @param arg additional arguments of @c OutgoingPendingInterest::send .
+   */
+  template<typename Pending, typename... Arg>
+  bool transmit(Pending& pending, const Arg&... arg) const {
+    ndnph::StaticRegion<512> region;
+    auto interest = region.create<ndnph::Interest>();
+    if (!isPending() || !interest) {
+      return false;
+    }
+    interest.setName(m_name);
+    interest.setLifetime(InterestLifetime::value);
+    if (m_params.size() == 0) {
+      return pending.send(interest, arg...);
+    }
+    return pending.send(interest.parameterize(m_params), arg...);
+  }
+
+  /** @brief Determine what to do in loop(). */
+  Action poll();
+
+  /** @brief Record that the outgoing Interest has been satisfied, and forget it. */
+  void satisfy();
+
+  /** @brief Determine whether an Interest is outstanding. */
+  bool isPending() const {
+    return m_counters != nullptr;
+  }
+
+  /**
+   * @brief Determine whether @p name is the name of the outstanding Interest.
+   *
+   * With AppParameters, the name is the saved name followed by a ParametersSha256DigestComponent.
+   * Unlike the PIT token, the name is the same in every transmission, so that it identifies a reply
+   * to an earlier transmission without accepting a late reply to an earlier Interest.
+   */
+  bool matchName(const ndnph::Name& name) const;
+
+  /** @brief Determine whether the outstanding Interest has been retransmitted. */
+  bool hasRetransmitted() const {
+    return m_nRetx > 0;
+  }
+
+  /** @brief Determine whether the time limit has been reached. */
+  bool isExpired() const;
+
+  /** @brief Return smoothed RTT in milliseconds, or -1 if there is no sample. */
+  int getSrtt() const {
+    return m_srtt;
+  }
+
+  /** @brief Return current retransmission timeout in milliseconds. */
+  int getRto() const {
+    return m_rto;
+  }
+
+private:
+  void addRttSample(int rtt);
+
+private:
+  std::unique_ptr<uint8_t[]> m_buffer; // name TLV-VALUE followed by AppParameters
+  ndnph::Name m_name;
+  ndnph::tlv::Value m_params;
+  RetxCounters* m_counters = nullptr;
+  ndnph::port::Clock::Time m_end{};
+  ndnph::port::Clock::Time m_firstSent{};
+  ndnph::port::Clock::Time m_lastSent{};
+  int m_srtt = -1;
+  int m_rttvar = 0;
+  int m_rto = InitialRto;
+  uint8_t m_nRetx = 0;
+};
+
 } // namespace pake
 } // namespace pion
 
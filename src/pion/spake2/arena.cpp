@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "arena.hpp"
+
+#include <mbedtls/platform.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(MBEDTLS_PLATFORM_MEMORY) && !defined(MBEDTLS_PLATFORM_CALLOC_MACRO)
+#define PION_SPAKE2_ARENA_HOOKS
+#endif
+
+// allocator that mbedtls would use without the hooks
+#ifdef MBEDTLS_PLATFORM_STD_CALLOC
+#define PION_SPAKE2_ARENA_STD_CALLOC MBEDTLS_PLATFORM_STD_CALLOC
+#define PION_SPAKE2_ARENA_STD_FREE MBEDTLS_PLATFORM_STD_FREE
+#else
+#define PION_SPAKE2_ARENA_STD_CALLOC std::calloc
+#define PION_SPAKE2_ARENA_STD_FREE std::free
+#endif
+
+namespace spake2 {
+
+namespace {
+
+thread_local Arena* t_current = nullptr;
+Arena* s_arenas = nullptr;
+
+} // namespace
+
+bool
+Arena::install() noexcept {
+#ifdef PION_SPAKE2_ARENA_HOOKS
+  return mbedtls_platform_set_calloc_free(hookCalloc, hookFree) == 0;
+#else
+  return false;
+#endif
+}
+
+Arena::Scope::Scope(Arena* arena) noexcept
+  : m_prev(t_current) {
+  if (arena != nullptr) {
+    t_current = arena;
+  }
+}
+
+Arena::Scope::~Scope() noexcept {
+  t_current = m_prev;
+}
+
+Arena::Arena(uint8_t* buf, size_t size) noexcept
+  : m_next(s_arenas) {
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(buf) + Align - 1) / Align * Align;
+  m_begin = reinterpret_cast<uint8_t*>(begin);
+  m_end = buf + size;
+  if (m_end < m_begin) {
+    m_end = m_begin;
+  }
+  clear();
+  s_arenas = this;
+}
+
+Arena::~Arena() noexcept {
+  assert(m_nLive == 0);
+  for (Arena** p = &s_arenas; *p != nullptr; p = &(*p)->m_next) {
+    if (*p == this) {
+      *p = m_next;
+      break;
+    }
+  }
+}
+
+void*
+Arena::alloc(size_t n, size_t size) noexcept {
+  if (n != 0 && size > std::numeric_limits<size_t>::max() / n) {
+    return nullptr;
+  }
+  size_t cap = std::max<size_t>((n * size + Align - 1) / Align, 1) * Align;
+  size_t cls = cap / Align;
+
+  Block* b = nullptr;
+  if (cls <= NClasses) {
+    b = m_free[cls - 1];
+    if (b != nullptr) {
+      m_free[cls - 1] = b->next;
+    }
+  } else {
+    for (Block** p = &m_free[NClasses]; *p != nullptr; p = &(*p)->next) {
+      if ((*p)->cap >= cap) {
+        b = *p;
+        *p = b->next;
+        break;
+      }
+    }
+  }
+
+  if (b == nullptr) {
+    if (static_cast<size_t>(m_end - m_top) < HeaderSize + cap) {
+      return nullptr;
+    }
+    b = reinterpret_cast<Block*>(m_top);
+    b->cap = cap;
+    m_top += HeaderSize + cap;
+  }
+
+  ++m_nLive;
+  m_used += HeaderSize + b->cap;
+  m_peak = std::max(m_peak, m_used);
+  uint8_t* payload = reinterpret_cast<uint8_t*>(b) + HeaderSize;
+  std::memset(payload, 0, b->cap);
+  return payload;
+}
+
+void
+Arena::free(void* ptr) noexcept {
+  Block* b = reinterpret_cast<Block*>(static_cast<uint8_t*>(ptr) - HeaderSize);
+  m_used -= HeaderSize + b->cap;
+  if (--m_nLive == 0) {
+    clear();
+    return;
+  }
+
+  size_t cls = b->cap / Align;
+  Block*& list = m_free[std::min<size_t>(cls, NClasses + 1) - 1];
+  b->next = list;
+  list = b;
+}
+
+void
+Arena::clear() noexcept {
+  m_top = m_begin;
+  std::fill_n(m_free, NClasses + 1, nullptr);
+  m_nLive = 0;
+  m_used = 0;
+}
+
+void*
+Arena::hookCalloc(size_t n, size_t size) {
+  Arena* arena = t_current;
+  if (arena != nullptr) {
+    void* ptr = arena->alloc(n, size);
+    if (ptr != nullptr) {
+      return ptr;
+    }
+    ++arena->m_nFallbacks;
+  }
+  return PION_SPAKE2_ARENA_STD_CALLOC(n, size);
+}
+
+void
+Arena::hookFree(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  for (Arena* arena = s_arenas; arena != nullptr; arena = arena->m_next) {
+    if (arena->owns(ptr)) {
+      arena->free(ptr);
+      return;
+    }
+  }
+  PION_SPAKE2_ARENA_STD_FREE(ptr);
+}
+
+} // namespace spake2
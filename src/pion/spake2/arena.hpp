@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_ARENA_HPP
+#define PION_SPAKE2_ARENA_HPP
+
+#include "mbedtls-wrappers.hpp"
+
+#include <cstddef>
+
+namespace spake2 {
+
+/**
+ * @brief Preallocated memory block that serves mbedtls allocations during SPAKE2 operations.
+ *
+ * Every bignum in a handshake, including the temporaries inside mbedtls, allocates its limbs
+ * through mbedtls_calloc(). When an Arena is active on the current thread, these allocations are
+ * carved from its block instead of the heap, and freed blocks are kept in free lists by size for
+ * reuse. Once every allocation has been freed, the whole block is released at once, so that the
+ * heap is not fragmented by onboarding. If the block is exhausted, the allocation falls back to
+ * the heap; peak() and nFallbacks() help sizing the block.
+ *
+ * Arena requires mbedtls to be built with MBEDTLS_PLATFORM_MEMORY. install() must be called once
+ * at startup, before any other mbedtls function. Arenas should be created and destroyed while no
+ * other thread uses mbedtls. An arena must only be active on one thread at a time.
+ */
+class Arena {
+public:
+  /** @brief Install the allocation hooks into mbedtls. */
+  static bool install() noexcept;
+
+  /**
+   * @brief Make an arena active on the current thread until the end of the scope.
+   * @param arena the arena, or nullptr to have no effect.
+   */
+  class Scope {
+  public:
+    explicit Scope(Arena* arena) noexcept;
+
+    ~Scope() noexcept;
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    Arena* m_prev;
+  };
+
+  /**
+   * @brief Constructor.
+   * @param buf memory block, which must outlive the arena.
+   * @param size block size in octets.
+   */
+  explicit Arena(uint8_t* buf, size_t size) noexcept;
+
+  ~Arena() noexcept;
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /** @brief Return the number of octets in use, including block headers. */
+  size_t used() const noexcept {
+    return m_used;
+  }
+
+  /** @brief Return the maximum of used() since construction or resetPeak(). */
+  size_t peak() const noexcept {
+    return m_peak;
+  }
+
+  /** @brief Return the number of allocations that did not fit and went to the heap. */
+  size_t nFallbacks() const noexcept {
+    return m_nFallbacks;
+  }
+
+  void resetPeak() noexcept {
+    m_peak = m_used;
+    m_nFallbacks = 0;
+  }
+
+private:
+  struct Block {
+    size_t cap;  // payload capacity
+    Block* next; // next free block of the same size, only meaningful while free
+  };
+
+  /** @brief Allocate zeroed memory, or return nullptr if the block is exhausted. */
+  void* alloc(size_t n, size_t size) noexcept;
+
+  /** @brief Determine whether @p ptr was allocated from this arena. */
+  bool owns(const void* ptr) const noexcept {
+    auto p = static_cast<const uint8_t*>(ptr);
+    return p >= m_begin && p < m_end;
+  }
+
+  void free(void* ptr) noexcept;
+
+  /** @brief Release all allocations at once. */
+  void clear() noexcept;
+
+  static void* hookCalloc(size_t n, size_t size);
+
+  static void hookFree(void* ptr);
+
+private:
+  enum : size_t {
+    Align = alignof(std::max_align_t),
+    HeaderSize = (sizeof(Block) + Align - 1) / Align * Align,
+    NClasses = 32, // exact-size free lists of blocks up to NClasses * Align octets
+  };
+
+  uint8_t* m_begin;
+  uint8_t* m_end;
+  uint8_t* m_top; // start of never-allocated space
+  Block* m_free[NClasses + 1]; // last list holds larger blocks
+  size_t m_nLive = 0;
+  size_t m_used = 0;
+  size_t m_peak = 0;
+  size_t m_nFallbacks = 0;
+  Arena* m_next; // registered arenas, consulted by hookFree()
+};
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_ARENA_HPP
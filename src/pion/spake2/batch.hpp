@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_BATCH_HPP
+#define PION_SPAKE2_BATCH_HPP
+
+#include "sha256-mb.hpp"
+#include "spake2.hpp"
+
+#include <type_traits>
+
+namespace spake2 {
+
+/**
+ * @brief Advance many contexts through their first messages together.
+ * @tparam Ctx Context type.
+ * @tparam Capacity maximum number of queued operations.
+ *
+ * Each queued operation is generateFirstMessage() or processFirstMessage() on a distinct context.
+ * run() performs all scalar multiplications, then converts their results to affine coordinates
+ * with one field inversion for up to 32 results (Montgomery's trick), and finally encodes the
+ * results and finishes each context. With SHA256, the HKDF and HMAC computations that follow
+ * processFirstMessage() are also performed together, on the lanes of Sha256Batch. Each operation
+ * has the same outcome as the function called on the context alone; a failed operation does not
+ * affect the others.
+ *
+ * The budget of Context::setMaxOps() is ignored: every multiplication runs to completion.
+ * A context must not be in the middle of an incremental operation.
+ *
+ * This class is not thread-safe. All contexts must belong to the calling thread.
+ */
+template<typename Ctx, size_t Capacity = 32>
+class Batch {
+public:
+  /**
+   * @brief Queue ctx.generateFirstMessage(outMsg, outMsgLen).
+   * @param outMsg output buffer, which must outlive run().
+   * @return whether success; false if the batch is full.
+   */
+  bool addGenerateFirstMessage(Ctx& ctx, uint8_t* outMsg, size_t outMsgLen) noexcept {
+    return add(ctx, false, outMsg, nullptr, outMsgLen);
+  }
+
+  /**
+   * @brief Queue ctx.processFirstMessage(inMsg, inMsgLen).
+   * @param inMsg input buffer, which must outlive run().
+   * @return whether success; false if the batch is full.
+   */
+  bool addProcessFirstMessage(Ctx& ctx, const uint8_t* inMsg, size_t inMsgLen) noexcept {
+    return add(ctx, true, nullptr, inMsg, inMsgLen);
+  }
+
+  /** @brief Return the number of queued operations. */
+  size_t size() const noexcept {
+    return m_size;
+  }
+
+  /**
+   * @brief Perform the queued operations.
+   * @return number of operations that succeeded.
+   */
+  size_t run() noexcept;
+
+  /**
+   * @brief Return whether the @p i -th queued operation succeeded.
+   * @pre run() has been called.
+   */
+  bool ok(size_t i) const noexcept {
+    return i < m_size && m_items[i].ok;
+  }
+
+  /** @brief Discard queued operations and their results. */
+  void clear() noexcept {
+    m_size = 0;
+  }
+
+private:
+  struct Item {
+    Ctx* ctx;
+    bool process; // processFirstMessage if true, generateFirstMessage if false
+    bool ok;
+    uint8_t* out;
+    const uint8_t* in;
+    size_t len;
+  };
+
+  /** @brief Finish the operations whose multiplications succeeded, one context at a time. */
+  size_t finish(std::false_type) noexcept;
+
+  /** @brief Finish the operations, sharing SHA-256 lanes for key derivation. */
+  size_t finish(std::true_type) noexcept;
+
+  bool add(Ctx& ctx, bool process, uint8_t* out, const uint8_t* in, size_t len) noexcept {
+    if (m_size == Capacity) {
+      return false;
+    }
+    m_items[m_size++] = Item{&ctx, process, false, out, in, len};
+    return true;
+  }
+
+private:
+  std::array<Item, Capacity> m_items{};
+  size_t m_size = 0;
+};
+
+template<typename Ctx, size_t Capacity>
+size_t
+Batch<Ctx, Capacity>::run() noexcept {
+  using Ops = typename Ctx::Ops;
+
+  // scalar multiplications, one context after another
+  std::array<Ops*, Capacity> ops{};
+  size_t nOps = 0;
+  for (size_t i = 0; i < m_size; ++i) {
+    Item& item = m_items[i];
+    Ctx& ctx = *item.ctx;
+    item.ok = ctx.m_step == 0 && (item.process ? ctx.canProcessFirstMessage()
+                                               : ctx.canGenerateFirstMessage(item.len));
+    if (!item.ok) {
+      continue;
+    }
+
+    Arena::Scope arenaScope(ctx.m_arena);
+    item.ok = item.process ? ctx.beginKey(item.in, item.len) : ctx.beginShare();
+    if (item.ok) {
+      int ret = ctx.runOps(0);
+      if (ret != 0) {
+        SPAKE2_MBED_ERR(ret);
+        item.ok = false;
+      }
+    }
+    if (!item.ok) {
+      ctx.fail();
+      continue;
+    }
+    ops[nOps++] = &ctx.m_ops;
+  }
+
+  // affine conversion with shared inversions; if this fails, writeResult() normalizes each result
+  {
+    SPAKE2_STATS_SCOPE(ScalarMul);
+    int ret = Ops::normalize(ops.data(), nOps);
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+    }
+  }
+
+  // encoding, transcript, and key derivation
+  return finish(std::is_same<typename Ctx::HashType, SHA256>());
+}
+
+template<typename Ctx, size_t Capacity>
+size_t
+Batch<Ctx, Capacity>::finish(std::false_type) noexcept {
+  size_t nOk = 0;
+  for (size_t i = 0; i < m_size; ++i) {
+    Item& item = m_items[i];
+    if (!item.ok) {
+      continue;
+    }
+    Ctx& ctx = *item.ctx;
+    Arena::Scope arenaScope(ctx.m_arena);
+    Progress progress = item.process ? ctx.finishKey() : ctx.finishShare(item.out, item.len);
+    item.ok = progress == Progress::Complete;
+    nOk += static_cast<size_t>(item.ok);
+  }
+  return nOk;
+}
+
+template<typename Ctx, size_t Capacity>
+size_t
+Batch<Ctx, Capacity>::finish(std::true_type) noexcept {
+  enum {
+    H = Sha256Batch::OutputSize,
+    InfoSize = Ctx::InfoCapacity + 1,
+  };
+  using Digest = uint8_t[H];
+
+  // complete the transcripts; public shares are finished right away
+  size_t nOk = 0;
+  Item* items[Capacity];
+  Digest transcriptHash[Capacity];
+  size_t n = 0;
+  for (size_t i = 0; i < m_size; ++i) {
+    Item& item = m_items[i];
+    if (!item.ok) {
+      continue;
+    }
+    Ctx& ctx = *item.ctx;
+    Arena::Scope arenaScope(ctx.m_arena);
+    if (!item.process) {
+      item.ok = ctx.finishShare(item.out, item.len) == Progress::Complete;
+      nOk += static_cast<size_t>(item.ok);
+      continue;
+    }
+
+    std::array<uint8_t, H> th;
+    item.ok = ctx.hashTranscript(th);
+    if (item.ok) {
+      std::copy(th.begin(), th.end(), transcriptHash[n]);
+      items[n++] = &item;
+    }
+    mbedtls_platform_zeroize(th.data(), th.size());
+  }
+
+  const uint8_t* key[2 * Capacity];
+  size_t keyLen[2 * Capacity];
+  const uint8_t* msg[2 * Capacity];
+  size_t msgLen[2 * Capacity];
+
+  SPAKE2_STATS_SCOPE(Kdf);
+
+  // HKDF-Extract with empty salt: PRK = HMAC(0^H, Ka)
+  static const uint8_t salt[H]{};
+  Digest prk[Capacity];
+  for (size_t i = 0; i < n; ++i) {
+    key[i] = salt;
+    keyLen[i] = H;
+    msg[i] = transcriptHash[i] + H / 2;
+    msgLen[i] = H / 2;
+  }
+  bool ok = Sha256Batch::hmac(n, key, keyLen, msg, msgLen, prk);
+
+  // HKDF-Expand: KcA || KcB = HMAC(PRK, info || 0x01)
+  uint8_t info[Capacity][InfoSize];
+  Digest Kc[Capacity];
+  for (size_t i = 0; i < n; ++i) {
+    const Ctx& ctx = *items[i]->ctx;
+    std::copy_n(ctx.m_info.data(), ctx.m_info.size(), info[i]);
+    info[i][ctx.m_info.size()] = 0x01;
+    key[i] = prk[i];
+    keyLen[i] = H;
+    msg[i] = info[i];
+    msgLen[i] = ctx.m_info.size() + 1;
+  }
+  ok = ok && Sha256Batch::hmac(n, key, keyLen, msg, msgLen, Kc);
+
+  // confirmation messages: HMAC(KcA, TT) and HMAC(KcB, TT)
+  Digest mac[2 * Capacity];
+  for (size_t i = 0; i < n; ++i) {
+    const Ctx& ctx = *items[i]->ctx;
+    for (size_t j = 0; j < 2; ++j) {
+      key[2 * i + j] = Kc[i] + j * H / 2;
+      keyLen[2 * i + j] = H / 2;
+      msg[2 * i + j] = ctx.m_transcript.data();
+      msgLen[2 * i + j] = ctx.m_transcript.size();
+    }
+  }
+  ok = ok && Sha256Batch::hmac(2 * n, key, keyLen, msg, msgLen, mac);
+
+  for (size_t i = 0; i < n; ++i) {
+    items[i]->ok = ok;
+    if (ok) {
+      items[i]->ctx->setConfirmation(mac[2 * i], mac[2 * i + 1]);
+    }
+    nOk += static_cast<size_t>(ok);
+  }
+
+  mbedtls_platform_zeroize(transcriptHash, sizeof(transcriptHash));
+  mbedtls_platform_zeroize(prk, sizeof(prk));
+  mbedtls_platform_zeroize(Kc, sizeof(Kc));
+  mbedtls_platform_zeroize(mac, sizeof(mac));
+  return nOk;
+}
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_BATCH_HPP
@@ -0,0 +1,660 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_CONTEXT_IMPL_HPP
+#define PION_SPAKE2_CONTEXT_IMPL_HPP
+
+#include "spake2.hpp"
+
+namespace spake2 {
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+Context<role, Group, Hash, Bounds>::Context(Random& random) noexcept
+  : m_random(random) {
+  auto mdInfo = mbedtls_md_info_from_type(Hash::Type);
+  assert(mdInfo != nullptr);
+
+  // Initialize digest and HMAC contexts
+  int ret = mbedtls_md_setup(m_md, mdInfo, 0);
+  assert(ret == 0);
+  ret = mbedtls_md_setup(m_transcriptMd, mdInfo, 0);
+  assert(ret == 0);
+  ret = mbedtls_md_setup(m_macA, mdInfo, 1);
+  assert(ret == 0);
+  ret = mbedtls_md_setup(m_macB, mdInfo, 1);
+  assert(ret == 0);
+
+  // EC group and protocol constants M and N are shared, see Group::Ops. They are built now, so
+  // that their allocations never come from an arena.
+  (void)Ops::order();
+
+  // KDF info string begins with a fixed label
+  static const uint8_t infoLabel[InfoLabelSize]{
+    'C', 'o', 'n', 'f', 'i', 'r', 'm', 'a', 't', 'i', 'o', 'n', 'K', 'e', 'y', 's',
+  };
+  m_info.append(infoLabel, sizeof(infoLabel));
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+void
+Context<role, Group, Hash, Bounds>::reset() noexcept {
+  // mbedtls_*_free() zeroizes the limbs and leaves the objects in their initialized state
+  mbedtls_mpi_free(m_w);
+  mbedtls_mpi_free(m_x);
+  Ops::clearPoint(m_X);
+  m_hasX = false;
+  Ops::clearPoint(m_wB);
+  m_hasWB = false;
+  m_ops.clear();
+
+  m_maxOps = 0;
+  m_arena = nullptr;
+  m_step = 0;
+
+  mbedtls_platform_zeroize(m_myMsg.data(), m_myMsg.size());
+  mbedtls_platform_zeroize(m_peerShare.data(), m_peerShare.size());
+  mbedtls_platform_zeroize(m_expectedMac.data(), m_expectedMac.size());
+  mbedtls_platform_zeroize(m_key.data(), m_key.size());
+
+  // The transcript contains w
+  m_transcript.truncate(0);
+  m_info.truncate(InfoLabelSize);
+
+  // The digest contexts keep the tail of the password and the transcript, and the HMAC contexts
+  // keep the ipad/opad derived from Kc. They are wiped in place rather than freed and set up
+  // again, so that reset() never allocates, possibly from an arena.
+  wipeMd(m_md);
+  wipeMd(m_transcriptMd);
+  wipeMd(m_macA);
+  wipeMd(m_macB);
+
+  m_state = State::Initial;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+void
+Context<role, Group, Hash, Bounds>::wipeMd(mbedtls_md_context_t* md) noexcept {
+  if (md->md_ctx != nullptr) {
+    mbedtls_platform_zeroize(md->md_ctx, sizeof(typename Hash::State));
+  }
+  if (md->hmac_ctx != nullptr) {
+    mbedtls_platform_zeroize(md->hmac_ctx, 2 * Hash::BlockSize);
+  }
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::start(const uint8_t* pw, size_t pwLen, const uint8_t* myId,
+                                          size_t myIdLen, const uint8_t* peerId, size_t peerIdLen,
+                                          const uint8_t* aad, size_t aadLen) noexcept {
+  // TODO: sanity-check state machine?
+  Arena::Scope arenaScope(m_arena);
+  if (!startTranscript(myId, myIdLen, peerId, peerIdLen, aad, aadLen)) {
+    return false;
+  }
+  m_hasWB = false;
+  return hashPassword(pw, pwLen) && generateX();
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::start(const Verifier<Group, Hash>& verifier,
+                                          const uint8_t* myId, size_t myIdLen,
+                                          const uint8_t* peerId, size_t peerIdLen,
+                                          const uint8_t* aad, size_t aadLen) noexcept {
+  using V = Verifier<Group, Hash>;
+  if (!verifier.isValid()) {
+    return false;
+  }
+  Arena::Scope arenaScope(m_arena);
+  if (!startTranscript(myId, myIdLen, peerId, peerIdLen, aad, aadLen)) {
+    return false;
+  }
+
+  int ret = mbedtls_mpi_read_binary(m_w, verifier.getW(), V::ScalarSize);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  // Take w*M (Alice) or w*N (Bob), if precomputed
+  uint8_t point = role == Role::Alice ? V::WithM : V::WithN;
+  m_hasWB = false;
+  if (verifier.has(point)) {
+    SPAKE2_STATS_SCOPE(PointValidate);
+    ret = Ops::decodePoint(m_wB, verifier.getPoint(point), V::PointSize);
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+      return false;
+    }
+    m_hasWB = true;
+  }
+
+  return generateX();
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::hashPassword(const uint8_t* pw, size_t pwLen) noexcept {
+  SPAKE2_STATS_SCOPE(Hash);
+  // Calculate the hash of the user-supplied password pw
+  std::array<uint8_t, Hash::OutputSize> pwHash{};
+  int ret = mbedtls_md_starts(m_md);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_update(m_md, pw, pwLen);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_finish(m_md, pwHash.data());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  ndnph::mbedtls::Mpi pwHashScalar;
+  ret = mbedtls_mpi_read_binary(pwHashScalar, pwHash.data(), pwHash.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_mpi_mod_mpi(m_w, pwHashScalar, Ops::order());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::startTranscript(const uint8_t* myId, size_t myIdLen,
+                                                    const uint8_t* peerId, size_t peerIdLen,
+                                                    const uint8_t* aad, size_t aadLen) noexcept {
+  if (myIdLen > Bounds::MaxIdLen || peerIdLen > Bounds::MaxIdLen || aadLen > Bounds::MaxAadLen) {
+    return false;
+  }
+
+  // Copy the identities into the transcript
+  m_transcript.truncate(0);
+  int ret = mbedtls_md_starts(m_transcriptMd);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  bool ok = role == Role::Alice
+              ? appendToTranscript(myId, myIdLen) && appendToTranscript(peerId, peerIdLen)
+              : appendToTranscript(peerId, peerIdLen) && appendToTranscript(myId, myIdLen);
+  if (!ok) {
+    return false;
+  }
+
+  // Append the Additional Authenticated Data (AAD) to the KDF info string
+  m_info.truncate(InfoLabelSize);
+  m_info.append(aad, aadLen);
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::generateX() noexcept {
+  SPAKE2_STATS_SCOPE(Random);
+  // Generate random scalar x
+  ndnph::mbedtls::Mpi random;
+  // NOTE: generate 8 extra bytes to avoid bias in modulo operation
+  int ret = mbedtls_mpi_fill_random(random, Group::ScalarSize + 8, Random::rng, &m_random);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_mpi_mod_mpi(m_x, random, Ops::order());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+Progress
+Context<role, Group, Hash, Bounds>::generateFirstMessageStep(uint8_t* outMsg,
+                                                             size_t outMsgLen) noexcept {
+  if (!canGenerateFirstMessage(outMsgLen)) {
+    return Progress::Failure;
+  }
+  Arena::Scope arenaScope(m_arena);
+
+  if (m_step == 0) {
+    if (!beginShare()) {
+      return fail();
+    }
+    m_step = 1;
+  }
+  int ret = runOps(m_maxOps);
+  if (ret == MBEDTLS_ERR_ECP_IN_PROGRESS) {
+    return Progress::InProgress;
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return fail();
+  }
+  m_step = 0;
+  return finishShare(outMsg, outMsgLen);
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::beginShare() noexcept {
+  SPAKE2_STATS_SCOPE(ScalarMul);
+  // pA = x * G + w * (M|N); X came from an EphemeralPool, w * (M|N) from a Verifier
+  int ret = m_ops.beginShare(m_x, m_hasX ? &m_X : nullptr, role == Role::Alice ? Base::M : Base::N,
+                             m_w, m_hasWB ? &m_wB : nullptr, Random::rng, &m_random);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+Progress
+Context<role, Group, Hash, Bounds>::finishShare(uint8_t* outMsg, size_t outMsgLen) noexcept {
+  SPAKE2_STATS_SCOPE(ScalarMul);
+  int ret = m_ops.writeResult(m_myMsg.data(), FirstMessageSize);
+  if (ret == 0 && outMsgLen != FirstMessageSize) {
+    ret = m_ops.writeResult(outMsg, outMsgLen);
+  } else if (ret == 0) {
+    std::memcpy(outMsg, m_myMsg.data(), outMsgLen);
+  }
+  m_ops.clear();
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+
+  m_state = State::AwaitingPublicShare;
+  return Progress::Complete;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::Checkpoint::writeShare(uint8_t* out,
+                                                          size_t len) const noexcept {
+  if (len == FirstMessageSize) {
+    std::copy_n(share, FirstMessageSize, out);
+    return true;
+  }
+  if (len != CompressedFirstMessageSize) {
+    return false;
+  }
+  // SEC1 compression: the prefix indicates the parity of y, which is the last octet
+  out[0] = static_cast<uint8_t>(0x02 | (share[FirstMessageSize - 1] & 0x01));
+  std::copy_n(share + 1, CompressedFirstMessageSize - 1, out + 1);
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::suspend(Checkpoint& checkpoint) noexcept {
+  if (m_state != State::AwaitingPublicShare || m_step != 0) {
+    return false;
+  }
+  int ret = mbedtls_mpi_write_binary(m_w, checkpoint.w, sizeof(checkpoint.w));
+  if (ret == 0) {
+    ret = mbedtls_mpi_write_binary(m_x, checkpoint.x, sizeof(checkpoint.x));
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    checkpoint.clear();
+    return false;
+  }
+  std::copy_n(m_myMsg.data(), FirstMessageSize, checkpoint.share);
+  reset();
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::resume(const Checkpoint& checkpoint, const uint8_t* myId,
+                                           size_t myIdLen, const uint8_t* peerId,
+                                           size_t peerIdLen, const uint8_t* aad,
+                                           size_t aadLen) noexcept {
+  if (m_state != State::Initial) {
+    return false;
+  }
+  Arena::Scope arenaScope(m_arena);
+  if (!startTranscript(myId, myIdLen, peerId, peerIdLen, aad, aadLen)) {
+    return false;
+  }
+  int ret = mbedtls_mpi_read_binary(m_w, checkpoint.w, sizeof(checkpoint.w));
+  if (ret == 0) {
+    ret = mbedtls_mpi_read_binary(m_x, checkpoint.x, sizeof(checkpoint.x));
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  std::copy_n(checkpoint.share, FirstMessageSize, m_myMsg.data());
+  m_state = State::AwaitingPublicShare;
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+Progress
+Context<role, Group, Hash, Bounds>::processFirstMessageStep(const uint8_t* inMsg,
+                                                            size_t inMsgLen) noexcept {
+  if (!canProcessFirstMessage()) {
+    return Progress::Failure;
+  }
+  Arena::Scope arenaScope(m_arena);
+
+  if (m_step == 0) {
+    if (!beginKey(inMsg, inMsgLen)) {
+      return fail();
+    }
+    m_step = 1;
+  }
+
+  int ret = runOps(m_maxOps);
+  if (ret == MBEDTLS_ERR_ECP_IN_PROGRESS) {
+    return Progress::InProgress;
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return fail();
+  }
+  m_step = 0;
+  return finishKey();
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::checkFirstMessage(const uint8_t* inMsg,
+                                                      size_t inMsgLen) noexcept {
+  if (inMsgLen != FirstMessageSize && inMsgLen != CompressedFirstMessageSize) {
+    return false;
+  }
+  SPAKE2_STATS_SCOPE(PointValidate);
+  typename Ops::Point P;
+  int ret = Ops::decodePoint(P, inMsg, inMsgLen);
+  Ops::clearPoint(P);
+  return ret == 0;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::beginKey(const uint8_t* inMsg, size_t inMsgLen) noexcept {
+  // K = h * x * (pB - w * (N|M)) = h * (x * pB + (-x * w) * (N|M))
+  // s = -x * w mod n, computed as ((x * b mod n) * w mod n) * b^-1 mod n with a random b, as in
+  // mbedtls_ecdsa_sign(), so that the variable-time reduction never sees an unblinded product
+  ndnph::mbedtls::Mpi s, b, bInv;
+  int ret = mbedtls_mpi_random(b, 1, Ops::order(), Random::rng, &m_random);
+  if (ret == 0) {
+    ret = mbedtls_mpi_inv_mod(bInv, b, Ops::order());
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_mul_mpi(s, m_x, b);
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_mod_mpi(s, s, Ops::order());
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_mul_mpi(s, s, m_w);
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_mod_mpi(s, s, Ops::order());
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_mul_mpi(s, s, bInv);
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_mod_mpi(s, s, Ops::order());
+  }
+  if (ret == 0 && mbedtls_mpi_cmp_int(s, 0) != 0) {
+    ret = mbedtls_mpi_sub_mpi(s, Ops::order(), s);
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  // The peer's share is validated here; m_peerShare receives its encoding for the transcript
+  ret = m_ops.beginKey(inMsg, inMsgLen, m_peerShare.data(), m_x,
+                       role == Role::Alice ? Base::N : Base::M, s, Random::rng, &m_random);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+Progress
+Context<role, Group, Hash, Bounds>::finishKey() noexcept {
+  std::array<uint8_t, Hash::OutputSize> transcriptHash{};
+  if (!hashTranscript(transcriptHash)) {
+    return Progress::Failure;
+  }
+  const uint8_t* Ka = transcriptHash.data() + transcriptHash.size() / 2;
+
+  // Derive confirmation keys (HKDF)
+  std::array<uint8_t, Hash::OutputSize> Kc{};
+  if (!deriveConfirmationKeys(Ka, transcriptHash.size() / 2, Kc)) {
+    return Progress::Failure;
+  }
+
+  const uint8_t* KcA = Kc.data();
+  const uint8_t* KcB = Kc.data() + Kc.size() / 2;
+
+  // Construct confirmation messages (HMAC)
+  // NOTE: each MAC covers the whole transcript TT, while its key is derived from the hash of TT,
+  //       so TT must be kept in m_transcript until now.
+  SPAKE2_STATS_SCOPE(Kdf);
+  int ret = mbedtls_md_hmac_starts(m_macA, KcA, Kc.size() / 2);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+  ret = mbedtls_md_hmac_starts(m_macB, KcB, Kc.size() / 2);
+  mbedtls_platform_zeroize(Kc.data(), Kc.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+  ret = mbedtls_md_hmac_update(m_macA, m_transcript.data(), m_transcript.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+  ret = mbedtls_md_hmac_update(m_macB, m_transcript.data(), m_transcript.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+  std::array<uint8_t, Hash::OutputSize> macA{};
+  ret = mbedtls_md_hmac_finish(m_macA, macA.data());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+  std::array<uint8_t, Hash::OutputSize> macB{};
+  ret = mbedtls_md_hmac_finish(m_macB, macB.data());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return Progress::Failure;
+  }
+
+  setConfirmation(macA.data(), macB.data());
+  return Progress::Complete;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::hashTranscript(
+  std::array<uint8_t, Hash::OutputSize>& transcriptHash) noexcept {
+  std::array<uint8_t, Group::UncompressedPointSize> binK{};
+  int ret = 0;
+  {
+    SPAKE2_STATS_SCOPE(ScalarMul);
+    ret = m_ops.writeResult(binK.data(), binK.size());
+    m_ops.clear();
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  std::array<uint8_t, Group::ScalarSize> binW{};
+  ret = mbedtls_mpi_write_binary(m_w, binW.data(), binW.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  // Finalize protocol transcript
+  bool ok = role == Role::Alice ? appendToTranscript(m_myMsg.data(), FirstMessageSize) &&
+                                    appendToTranscript(m_peerShare.data(), FirstMessageSize)
+                                : appendToTranscript(m_peerShare.data(), FirstMessageSize) &&
+                                    appendToTranscript(m_myMsg.data(), FirstMessageSize);
+  ok = ok && appendToTranscript(binK.data(), binK.size()) &&
+       appendToTranscript(binW.data(), binW.size());
+  if (!ok) {
+    return false;
+  }
+
+  // Calculate the hash of the transcript, which has been fed as it was appended
+  {
+    SPAKE2_STATS_SCOPE(Hash);
+    ret = mbedtls_md_finish(m_transcriptMd, transcriptHash.data());
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  const uint8_t* Ke = transcriptHash.data();
+  std::memcpy(m_key.data(), Ke, m_key.size());
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+void
+Context<role, Group, Hash, Bounds>::setConfirmation(const uint8_t* macA,
+                                                    const uint8_t* macB) noexcept {
+  if (role == Role::Alice) {
+    std::memcpy(m_myMsg.data(), macA, Hash::OutputSize);
+    std::memcpy(m_expectedMac.data(), macB, Hash::OutputSize);
+  } else {
+    std::memcpy(m_myMsg.data(), macB, Hash::OutputSize);
+    std::memcpy(m_expectedMac.data(), macA, Hash::OutputSize);
+  }
+
+  m_state = State::SendingConfirmation;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::appendToTranscript(const uint8_t* buf, size_t buflen) noexcept {
+  SPAKE2_STATS_SCOPE(Hash);
+  size_t pos = m_transcript.size();
+  if (!detail::appendToTranscript(m_transcript, buf, buflen)) {
+    return false;
+  }
+
+  int ret = mbedtls_md_update(m_transcriptMd, m_transcript.data() + pos, m_transcript.size() - pos);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::deriveConfirmationKeys(
+  const uint8_t* Ka, size_t KaLen, std::array<uint8_t, Hash::OutputSize>& Kc) noexcept {
+  SPAKE2_STATS_SCOPE(Kdf);
+  // HKDF-Extract with empty salt, i.e. HashLen zero octets
+  static const uint8_t salt[Hash::OutputSize]{};
+  std::array<uint8_t, Hash::OutputSize> prk{};
+  int ret = mbedtls_md_hmac_starts(m_macA, salt, sizeof(salt));
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_hmac_update(m_macA, Ka, KaLen);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_hmac_finish(m_macA, prk.data());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  // HKDF-Expand: Kc is exactly one output block T(1) = HMAC(PRK, info || 0x01)
+  static const uint8_t counter = 0x01;
+  ret = mbedtls_md_hmac_starts(m_macA, prk.data(), prk.size());
+  mbedtls_platform_zeroize(prk.data(), prk.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_hmac_update(m_macA, m_info.data(), m_info.size());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_hmac_update(m_macA, &counter, sizeof(counter));
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  ret = mbedtls_md_hmac_finish(m_macA, Kc.data());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::generateSecondMessage(uint8_t* outMsg,
+                                                          size_t outMsgLen) noexcept {
+  if (m_state != State::SendingConfirmation) {
+    return false;
+  }
+
+  // TODO: sanity checks
+  std::memcpy(outMsg, m_myMsg.data(), outMsgLen);
+
+  m_state = State::AwaitingConfirmation;
+  return true;
+}
+
+template<Role role, typename Group, typename Hash, typename Bounds>
+bool
+Context<role, Group, Hash, Bounds>::processSecondMessage(const uint8_t* inMsg,
+                                                         size_t inMsgLen) noexcept {
+  if (m_state != State::AwaitingConfirmation) {
+    return false;
+  }
+
+  // Check that the peer's MAC matches the one we expect
+  if (!ndnph::port::TimingSafeEqual()(inMsg, inMsgLen, m_expectedMac.data(),
+                                      m_expectedMac.size())) {
+    return false;
+  }
+
+  m_state = State::Done;
+  return true;
+}
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_CONTEXT_IMPL_HPP
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "cpu.hpp"
+
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PION_SPAKE2_CPU_X86
+#include <cpuid.h>
+#endif
+
+namespace spake2 {
+namespace {
+
+#ifdef PION_SPAKE2_CPU_X86
+/** @brief Read extended control register 0, which tells the register state saved by the OS. */
+uint64_t
+readXcr0() {
+  uint32_t lo = 0, hi = 0;
+  __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+  return static_cast<uint64_t>(hi) << 32 | lo;
+}
+#endif
+
+CpuFeatures
+detect() {
+  CpuFeatures f;
+#ifdef PION_SPAKE2_CPU_X86
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+    return f;
+  }
+  // AVX2 also requires the OS to save the XMM and YMM registers on context switches
+  bool hasYmm = (ecx & bit_OSXSAVE) != 0 && (ecx & bit_AVX) != 0 && (readXcr0() & 0x06) == 0x06;
+
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0) {
+    return f;
+  }
+  f.avx2 = hasYmm && (ebx & bit_AVX2) != 0;
+#endif
+  return f;
+}
+
+} // namespace
+
+const CpuFeatures&
+CpuFeatures::get() noexcept {
+  static const CpuFeatures features = detect();
+  return features;
+}
+
+} // namespace spake2
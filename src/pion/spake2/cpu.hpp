@@ -0,0 +1,23 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_CPU_HPP
+#define PION_SPAKE2_CPU_HPP
+
+namespace spake2 {
+
+/**
+ * @brief Processor features, detected once on first use.
+ *
+ * Only AVX2 is reported, which selects the batched SHA-256 kernel in sha256-mb.cpp after its
+ * self-test. On processors other than x86-64, it is reported as absent.
+ */
+struct CpuFeatures {
+  bool avx2 = false; ///< x86 AVX2, with operating system support of the YMM registers
+
+  /** @brief Return the features of the current processor. */
+  static const CpuFeatures& get() noexcept;
+};
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_CPU_HPP
@@ -0,0 +1,795 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "spake2.hpp"
+
+namespace spake2 {
+namespace detail {
+namespace {
+
+using Fe = Edwards25519Ops::Fe;
+using Point = Edwards25519Ops::Point;
+using Cached = Edwards25519Ops::Cached;
+using Table = Edwards25519Ops::Table;
+
+// Limb i holds 26 bits if i is even, 25 bits if i is odd. After a carry, limbs are in
+// [-2^25, 2^25] and [-2^24, 2^24] respectively. The first operand of feMul() may be a sum or
+// difference of up to four carried elements, and the second of up to three, so that 19 times a
+// limb still fits in 32 bits and the accumulators do not overflow.
+
+inline int
+limbWidth(int i) {
+  return 26 - (i & 1);
+}
+
+// d = -121665/121666
+const Fe D{{56195235, 13857412, 51736253, 6949390, 114729, 24766616, 60832955, 30306712, 48412415,
+            21499315}};
+// 2 * d
+const Fe D2{{45281625, 27714825, 36363642, 13898781, 229458, 15978800, 54557047, 27058993,
+             29715967, 9444199}};
+// sqrt(-1) = 2^((p-1)/4)
+const Fe SqrtM1{{34513072, 25610706, 9377949, 3500415, 12389472, 33281959, 41962654, 31548777,
+                 326685, 11406482}};
+
+// encoding of the base point, y = 4/5
+const uint8_t G[]{
+  0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+  0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+};
+
+// group order L = 2^252 + 27742317777372353535851937790883648493, big endian
+const uint8_t L[]{
+  0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x14, 0xde, 0xf9, 0xde, 0xa2, 0xf7, 0x9c, 0xd6, 0x58, 0x12, 0x63, 0x1a, 0x5c, 0xf5, 0xd3, 0xed,
+};
+
+void
+feSet(Fe& h, int32_t v) {
+  h = Fe{};
+  h.v[0] = v;
+}
+
+void
+feAdd(Fe& h, const Fe& f, const Fe& g) {
+  for (int i = 0; i < 10; ++i) {
+    h.v[i] = f.v[i] + g.v[i];
+  }
+}
+
+void
+feSub(Fe& h, const Fe& f, const Fe& g) {
+  for (int i = 0; i < 10; ++i) {
+    h.v[i] = f.v[i] - g.v[i];
+  }
+}
+
+void
+feNeg(Fe& h, const Fe& f) {
+  for (int i = 0; i < 10; ++i) {
+    h.v[i] = -f.v[i];
+  }
+}
+
+/** @brief f = g if b == 1, unchanged if b == 0, without branches. */
+void
+feCmov(Fe& f, const Fe& g, uint32_t b) {
+  int32_t mask = -static_cast<int32_t>(b);
+  for (int i = 0; i < 10; ++i) {
+    f.v[i] ^= (f.v[i] ^ g.v[i]) & mask;
+  }
+}
+
+/** @brief Propagate carries through 64-bit limbs, and store them into @p h . */
+void
+feCarry(Fe& h, int64_t t[10]) {
+  for (int i = 0; i < 10; ++i) {
+    int w = limbWidth(i);
+    int64_t c = (t[i] + (int64_t(1) << (w - 1))) >> w;
+    t[i] -= c * (int64_t(1) << w);
+    if (i < 9) {
+      t[i + 1] += c;
+    } else {
+      t[0] += 19 * c; // 2^255 = 19
+    }
+  }
+  int64_t c = (t[0] + (int64_t(1) << 25)) >> 26;
+  t[0] -= c * (int64_t(1) << 26);
+  t[1] += c;
+  for (int i = 0; i < 10; ++i) {
+    h.v[i] = static_cast<int32_t>(t[i]);
+  }
+}
+
+void
+feCarry(Fe& h) {
+  int64_t t[10];
+  std::copy_n(h.v, 10, t);
+  feCarry(h, t);
+}
+
+/** @brief Multiply two signed 32-bit integers into a 64-bit integer, with a single instruction. */
+inline int64_t
+mul64(int32_t a, int32_t b) {
+  return static_cast<int64_t>(a) * b;
+}
+
+void
+feMul(Fe& h, const Fe& f, const Fe& g) {
+  // limb i+j wraps around with a factor of 19; two odd limbs leave an extra factor of 2
+  const int32_t f0 = f.v[0], f1 = f.v[1], f2 = f.v[2], f3 = f.v[3], f4 = f.v[4];
+  const int32_t f5 = f.v[5], f6 = f.v[6], f7 = f.v[7], f8 = f.v[8], f9 = f.v[9];
+  const int32_t g0 = g.v[0], g1 = g.v[1], g2 = g.v[2], g3 = g.v[3], g4 = g.v[4];
+  const int32_t g5 = g.v[5], g6 = g.v[6], g7 = g.v[7], g8 = g.v[8], g9 = g.v[9];
+  const int32_t f1_2 = 2 * f1, f3_2 = 2 * f3, f5_2 = 2 * f5, f7_2 = 2 * f7, f9_2 = 2 * f9;
+  const int32_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+  const int32_t g5_19 = 19 * g5, g6_19 = 19 * g6, g7_19 = 19 * g7, g8_19 = 19 * g8;
+  const int32_t g9_19 = 19 * g9;
+
+  int64_t t[10];
+  t[0] = mul64(f0, g0) + mul64(f1_2, g9_19) + mul64(f2, g8_19) + mul64(f3_2, g7_19) +
+         mul64(f4, g6_19) + mul64(f5_2, g5_19) + mul64(f6, g4_19) + mul64(f7_2, g3_19) +
+         mul64(f8, g2_19) + mul64(f9_2, g1_19);
+  t[1] = mul64(f0, g1) + mul64(f1, g0) + mul64(f2, g9_19) + mul64(f3, g8_19) + mul64(f4, g7_19) +
+         mul64(f5, g6_19) + mul64(f6, g5_19) + mul64(f7, g4_19) + mul64(f8, g3_19) +
+         mul64(f9, g2_19);
+  t[2] = mul64(f0, g2) + mul64(f1_2, g1) + mul64(f2, g0) + mul64(f3_2, g9_19) + mul64(f4, g8_19) +
+         mul64(f5_2, g7_19) + mul64(f6, g6_19) + mul64(f7_2, g5_19) + mul64(f8, g4_19) +
+         mul64(f9_2, g3_19);
+  t[3] = mul64(f0, g3) + mul64(f1, g2) + mul64(f2, g1) + mul64(f3, g0) + mul64(f4, g9_19) +
+         mul64(f5, g8_19) + mul64(f6, g7_19) + mul64(f7, g6_19) + mul64(f8, g5_19) +
+         mul64(f9, g4_19);
+  t[4] = mul64(f0, g4) + mul64(f1_2, g3) + mul64(f2, g2) + mul64(f3_2, g1) + mul64(f4, g0) +
+         mul64(f5_2, g9_19) + mul64(f6, g8_19) + mul64(f7_2, g7_19) + mul64(f8, g6_19) +
+         mul64(f9_2, g5_19);
+  t[5] = mul64(f0, g5) + mul64(f1, g4) + mul64(f2, g3) + mul64(f3, g2) + mul64(f4, g1) +
+         mul64(f5, g0) + mul64(f6, g9_19) + mul64(f7, g8_19) + mul64(f8, g7_19) + mul64(f9, g6_19);
+  t[6] = mul64(f0, g6) + mul64(f1_2, g5) + mul64(f2, g4) + mul64(f3_2, g3) + mul64(f4, g2) +
+         mul64(f5_2, g1) + mul64(f6, g0) + mul64(f7_2, g9_19) + mul64(f8, g8_19) +
+         mul64(f9_2, g7_19);
+  t[7] = mul64(f0, g7) + mul64(f1, g6) + mul64(f2, g5) + mul64(f3, g4) + mul64(f4, g3) +
+         mul64(f5, g2) + mul64(f6, g1) + mul64(f7, g0) + mul64(f8, g9_19) + mul64(f9, g8_19);
+  t[8] = mul64(f0, g8) + mul64(f1_2, g7) + mul64(f2, g6) + mul64(f3_2, g5) + mul64(f4, g4) +
+         mul64(f5_2, g3) + mul64(f6, g2) + mul64(f7_2, g1) + mul64(f8, g0) + mul64(f9_2, g9_19);
+  t[9] = mul64(f0, g9) + mul64(f1, g8) + mul64(f2, g7) + mul64(f3, g6) + mul64(f4, g5) +
+         mul64(f5, g4) + mul64(f6, g3) + mul64(f7, g2) + mul64(f8, g1) + mul64(f9, g0);
+
+  feCarry(h, t);
+}
+
+void
+feSq(Fe& h, const Fe& f) {
+  feMul(h, f, f);
+}
+
+/** @brief h = f^(2^k). */
+void
+fePow2k(Fe& h, const Fe& f, int k) {
+  feSq(h, f);
+  for (int i = 1; i < k; ++i) {
+    feSq(h, h);
+  }
+}
+
+/** @brief Compute z^(2^250 - 1) and z^11, which are shared by feInvert() and fePow22523(). */
+void
+fePow250(Fe& z250, Fe& z11, const Fe& z) {
+  Fe t0, t1, t2;
+  feSq(t0, z);
+  fePow2k(t1, t0, 2);
+  feMul(t1, z, t1);
+  feMul(z11, t0, t1);
+  feSq(t0, z11);
+  feMul(t1, t1, t0); // z^(2^5 - 1)
+  fePow2k(t0, t1, 5);
+  feMul(t1, t0, t1); // z^(2^10 - 1)
+  fePow2k(t0, t1, 10);
+  feMul(t0, t0, t1); // z^(2^20 - 1)
+  fePow2k(t2, t0, 20);
+  feMul(t0, t2, t0); // z^(2^40 - 1)
+  fePow2k(t0, t0, 10);
+  feMul(t1, t0, t1); // z^(2^50 - 1)
+  fePow2k(t0, t1, 50);
+  feMul(t0, t0, t1); // z^(2^100 - 1)
+  fePow2k(t2, t0, 100);
+  feMul(t0, t2, t0); // z^(2^200 - 1)
+  fePow2k(t0, t0, 50);
+  feMul(z250, t0, t1);
+}
+
+/** @brief h = z^(p - 2) = 1/z. h may alias z. */
+void
+feInvert(Fe& h, const Fe& z) {
+  Fe z250, z11;
+  fePow250(z250, z11, z);
+  fePow2k(h, z250, 5);
+  feMul(h, h, z11);
+}
+
+/** @brief h = z^((p - 5) / 8). h may alias z. */
+void
+fePow22523(Fe& h, const Fe& z) {
+  Fe z250, z11;
+  fePow250(z250, z11, z);
+  fePow2k(z250, z250, 2);
+  feMul(h, z250, z);
+}
+
+/** @brief Decode 255 bits, ignoring the most significant bit. */
+void
+feFromBytes(Fe& h, const uint8_t s[32]) {
+  int64_t t[10];
+  int pos = 0;
+  for (int i = 0; i < 10; ++i) {
+    const uint8_t* b = &s[pos >> 3];
+    uint32_t word = static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) |
+                    (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    int w = limbWidth(i);
+    t[i] = (word >> (pos & 7)) & ((uint32_t(1) << w) - 1);
+    pos += w;
+  }
+  feCarry(h, t);
+}
+
+/** @brief Encode the unique representative in [0, p). */
+void
+feToBytes(uint8_t s[32], const Fe& f) {
+  int64_t t[10];
+  std::copy_n(f.v, 10, t);
+  Fe h;
+  feCarry(h, t);
+  std::copy_n(h.v, 10, t);
+
+  // q = floor(h / p), which is -1, 0, or 1
+  int64_t q = (19 * t[9] + (int64_t(1) << 24)) >> 25;
+  for (int i = 0; i < 10; ++i) {
+    q = (t[i] + q) >> limbWidth(i);
+  }
+
+  // h - q * p = h + 19 * q - q * 2^255, where the last term is dropped by the carries
+  t[0] += 19 * q;
+  for (int i = 0; i < 10; ++i) {
+    int w = limbWidth(i);
+    int64_t c = t[i] >> w;
+    t[i] -= c * (int64_t(1) << w);
+    if (i < 9) {
+      t[i + 1] += c;
+    }
+  }
+
+  uint64_t acc = 0;
+  int nBits = 0;
+  uint8_t* out = s;
+  for (int i = 0; i < 10; ++i) {
+    acc |= static_cast<uint64_t>(t[i]) << nBits;
+    nBits += limbWidth(i);
+    for (; nBits >= 8; nBits -= 8) {
+      *out++ = static_cast<uint8_t>(acc);
+      acc >>= 8;
+    }
+  }
+  *out = static_cast<uint8_t>(acc);
+}
+
+bool
+feIsZero(const Fe& f) {
+  uint8_t s[32];
+  feToBytes(s, f);
+  uint8_t acc = 0;
+  for (uint8_t b : s) {
+    acc |= b;
+  }
+  return acc == 0;
+}
+
+int
+feIsNegative(const Fe& f) {
+  uint8_t s[32];
+  feToBytes(s, f);
+  return s[0] & 0x01;
+}
+
+void
+ptIdentity(Point& P) {
+  feSet(P.X, 0);
+  feSet(P.Y, 1);
+  feSet(P.Z, 1);
+  feSet(P.T, 0);
+}
+
+/** @brief R = 2 * P. R may alias P. */
+void
+ptDouble(Point& R, const Point& P) {
+  Fe a, b, c, e, f, g, h;
+  feSq(a, P.X);
+  feSq(b, P.Y);
+  feSq(c, P.Z);
+  feAdd(c, c, c);
+  feAdd(h, a, b);
+  feAdd(e, P.X, P.Y);
+  feSq(e, e);
+  feSub(e, h, e);
+  feSub(g, a, b);
+  feAdd(f, c, g);
+  feMul(R.X, f, e);
+  feMul(R.Y, g, h);
+  feMul(R.T, e, h);
+  feMul(R.Z, f, g);
+}
+
+/** @brief R = P + Q. R may alias P. */
+void
+ptAdd(Point& R, const Point& P, const Cached& Q) {
+  Fe a, b, c, d, e, f, g, h;
+  feSub(a, P.Y, P.X);
+  feMul(a, a, Q.YmX);
+  feAdd(b, P.Y, P.X);
+  feMul(b, b, Q.YpX);
+  feMul(c, P.T, Q.T2d);
+  feMul(d, P.Z, Q.Z2);
+  feSub(e, b, a);
+  feSub(f, d, c);
+  feAdd(g, d, c);
+  feAdd(h, b, a);
+  feMul(R.X, e, f);
+  feMul(R.Y, g, h);
+  feMul(R.T, e, h);
+  feMul(R.Z, f, g);
+}
+
+void
+ptToCached(Cached& C, const Point& P) {
+  feAdd(C.YpX, P.Y, P.X);
+  feCarry(C.YpX);
+  feSub(C.YmX, P.Y, P.X);
+  feCarry(C.YmX);
+  feMul(C.T2d, P.T, D2);
+  feAdd(C.Z2, P.Z, P.Z);
+  feCarry(C.Z2);
+}
+
+/** @brief Decode a point as in RFC 8032 section 5.1.3. */
+bool
+ptDecode(Point& P, const uint8_t s[32]) {
+  feFromBytes(P.Y, s);
+  // reject y >= p
+  uint8_t check[32];
+  feToBytes(check, P.Y);
+  check[31] |= s[31] & 0x80;
+  if (std::memcmp(check, s, sizeof(check)) != 0) {
+    return false;
+  }
+  feSet(P.Z, 1);
+
+  // x^2 = u / v, where u = y^2 - 1 and v = d * y^2 + 1
+  Fe u, v, v3, t;
+  feSq(u, P.Y);
+  feMul(v, u, D);
+  feSub(u, u, P.Z);
+  feAdd(v, v, P.Z);
+
+  // x = u * v^3 * (u * v^7)^((p - 5) / 8)
+  feSq(v3, v);
+  feMul(v3, v3, v);
+  feSq(P.X, v3);
+  feMul(P.X, P.X, v);
+  feMul(P.X, P.X, u);
+  fePow22523(P.X, P.X);
+  feMul(P.X, P.X, v3);
+  feMul(P.X, P.X, u);
+
+  feSq(t, P.X);
+  feMul(t, t, v);
+  Fe chk;
+  feSub(chk, t, u);
+  if (!feIsZero(chk)) {
+    feAdd(chk, t, u);
+    if (!feIsZero(chk)) {
+      return false;
+    }
+    feMul(P.X, P.X, SqrtM1);
+  }
+
+  int sign = s[31] >> 7;
+  if (feIsZero(P.X) && sign == 1) {
+    return false;
+  }
+  if (feIsNegative(P.X) != sign) {
+    feNeg(P.X, P.X);
+  }
+  feMul(P.T, P.X, P.Y);
+  return true;
+}
+
+/** @brief Determine whether Z is exactly the representation of 1 set by ptScale(). */
+bool
+ptIsAffine(const Point& P) {
+  Fe one;
+  feSet(one, 1);
+  return std::equal(P.Z.v, P.Z.v + 10, one.v);
+}
+
+/** @brief Multiply X, Y, and T by @p zInv = 1/Z, and set Z = 1. */
+void
+ptScale(Point& P, const Fe& zInv) {
+  feMul(P.X, P.X, zInv);
+  feMul(P.Y, P.Y, zInv);
+  feMul(P.T, P.T, zInv);
+  feSet(P.Z, 1);
+}
+
+void
+ptEncode(uint8_t s[32], const Point& P) {
+  Fe x = P.X, y = P.Y;
+  if (!ptIsAffine(P)) {
+    Fe zInv;
+    feInvert(zInv, P.Z);
+    feMul(x, P.X, zInv);
+    feMul(y, P.Y, zInv);
+  }
+  feToBytes(s, y);
+  s[31] ^= static_cast<uint8_t>(feIsNegative(x) << 7);
+}
+
+/** @brief Fill @p table with 1*P to 8*P. */
+void
+makeTable(Table& table, const Point& P) {
+  Point Q = P;
+  ptToCached(table[0], P);
+  for (size_t i = 1; i < table.size(); ++i) {
+    ptAdd(Q, Q, table[0]);
+    ptToCached(table[i], Q);
+  }
+}
+
+/** @brief R = d * P, where P is given by its table and d is in [-8, 8], reading every entry. */
+void
+select(Cached& R, const Table& table, int8_t d) {
+  uint8_t neg = static_cast<uint8_t>(d) >> 7;
+  int mask = -static_cast<int>(neg);
+  uint32_t abs = static_cast<uint32_t>((d ^ mask) - mask);
+
+  // neutral element
+  feSet(R.YpX, 1);
+  feSet(R.YmX, 1);
+  feSet(R.T2d, 0);
+  feSet(R.Z2, 2);
+  for (size_t i = 0; i < table.size(); ++i) {
+    // 1 if abs == i + 1, 0 otherwise, without branches
+    uint32_t eq = ((abs ^ static_cast<uint32_t>(i + 1)) - 1) >> 31;
+    feCmov(R.YpX, table[i].YpX, eq);
+    feCmov(R.YmX, table[i].YmX, eq);
+    feCmov(R.T2d, table[i].T2d, eq);
+    feCmov(R.Z2, table[i].Z2, eq);
+  }
+
+  // -(Y+X, Y-X, 2dT, 2Z) = (Y-X, Y+X, -2dT, 2Z)
+  Cached negR = R;
+  negR.YpX = R.YmX;
+  negR.YmX = R.YpX;
+  feNeg(negR.T2d, R.T2d);
+  feCmov(R.YpX, negR.YpX, neg);
+  feCmov(R.YmX, negR.YmX, neg);
+  feCmov(R.T2d, negR.T2d, neg);
+}
+
+/**
+ * @brief Recode a scalar below 2^255 into signed 4-bit digits in [-8, 8].
+ * @return 0, or an error code if the scalar is too large.
+ */
+int
+recode(int8_t digits[Edwards25519Ops::Windows], const mbedtls_mpi* k) {
+  uint8_t buf[Edwards25519Ops::ScalarSize];
+  int ret = mbedtls_mpi_write_binary_le(k, buf, sizeof(buf));
+  if (ret != 0) {
+    return ret;
+  }
+  if ((buf[31] & 0x80) != 0) {
+    mbedtls_platform_zeroize(buf, sizeof(buf));
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+
+  for (int i = 0; i < 32; ++i) {
+    digits[2 * i] = buf[i] & 0x0F;
+    digits[2 * i + 1] = buf[i] >> 4;
+  }
+  int carry = 0;
+  for (int i = 0; i < Edwards25519Ops::Windows - 1; ++i) {
+    int d = digits[i] + carry;
+    carry = (d + 8) >> 4;
+    digits[i] = static_cast<int8_t>(d - carry * 16);
+  }
+  digits[Edwards25519Ops::Windows - 1] += carry;
+  mbedtls_platform_zeroize(buf, sizeof(buf));
+  return 0;
+}
+
+/** @brief Process windows [pos - nWindows, pos) of m * P + n * Q into the accumulator R. */
+void
+runWindows(Point& R, const Table& tP, const int8_t* m, const Table* tQ, const int8_t* n,
+           unsigned pos, unsigned nWindows) {
+  Cached C;
+  for (; nWindows > 0; --nWindows) {
+    --pos;
+    if (pos < Edwards25519Ops::Windows - 1) {
+      for (int i = 0; i < 4; ++i) {
+        ptDouble(R, R);
+      }
+    }
+    select(C, tP, m[pos]);
+    ptAdd(R, R, C);
+    if (tQ != nullptr) {
+      select(C, *tQ, n[pos]);
+      ptAdd(R, R, C);
+    }
+  }
+  mbedtls_platform_zeroize(&C, sizeof(C));
+}
+
+/** @brief Process-wide tables of G, M, and N, built on first use. */
+class Bases {
+public:
+  static const Bases& get() {
+    static Bases instance;
+    return instance;
+  }
+
+  const Table& table(Edwards25519Ops::Base base) const {
+    return m_tables[static_cast<int>(base)];
+  }
+
+  const mbedtls_mpi* order() const {
+    return m_order;
+  }
+
+private:
+  Bases() {
+    const uint8_t* const points[] = {G, Edwards25519::M, Edwards25519::N};
+    for (int i = 0; i < 3; ++i) {
+      Point P;
+      bool ok = ptDecode(P, points[i]);
+      assert(ok);
+      (void)ok;
+      makeTable(m_tables[i], P);
+    }
+
+    int ret = mbedtls_mpi_read_binary(m_order, L, sizeof(L));
+    assert(ret == 0);
+    (void)ret;
+  }
+
+private:
+  Table m_tables[3];
+  ndnph::mbedtls::Mpi m_order;
+};
+
+} // namespace
+
+const mbedtls_mpi*
+Edwards25519Ops::order() noexcept {
+  return Bases::get().order();
+}
+
+int
+Edwards25519Ops::mulBase(Point& X, const mbedtls_mpi* x, int (*)(void*, unsigned char*, size_t),
+                         void*, Base base) noexcept {
+  int8_t digits[Windows];
+  int ret = recode(digits, x);
+  if (ret != 0) {
+    return ret;
+  }
+  ptIdentity(X);
+  runWindows(X, Bases::get().table(base), digits, nullptr, nullptr, Windows, Windows);
+  mbedtls_platform_zeroize(digits, sizeof(digits));
+  return 0;
+}
+
+int
+Edwards25519Ops::decodePoint(Point& P, const uint8_t* buf, size_t len) noexcept {
+  if (len != PointSize || !ptDecode(P, buf)) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+  return 0;
+}
+
+int
+Edwards25519Ops::encodePoint(uint8_t* out, size_t len, const Point& P) noexcept {
+  if (len != PointSize) {
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+  // neutral element has x = 0 and y = 1
+  Fe zero;
+  feSub(zero, P.Y, P.Z);
+  if (feIsZero(P.X) && feIsZero(zero)) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+  ptEncode(out, P);
+  return 0;
+}
+
+int
+Edwards25519Ops::begin(const Table& tP, const mbedtls_mpi* m, const Table* tQ,
+                       const mbedtls_mpi* n) noexcept {
+  int ret = recode(m_m, m);
+  if (ret == 0 && tQ != nullptr) {
+    ret = recode(m_n, n);
+  }
+  if (ret != 0) {
+    clear();
+    return ret;
+  }
+  m_tP = &tP;
+  m_tQ = tQ;
+  m_pos = Windows;
+  m_hasPeer = false;
+  ptIdentity(m_acc);
+  return 0;
+}
+
+int
+Edwards25519Ops::beginShare(const mbedtls_mpi* x, Point* X, Base base, const mbedtls_mpi* w,
+                            Point* wB, int (*)(void*, unsigned char*, size_t), void*) noexcept {
+  const Bases& bases = Bases::get();
+  m_nDoubles = 0;
+  if (X == nullptr && wB == nullptr) {
+    m_addend = nullptr;
+    return begin(bases.table(Base::G), x, &bases.table(base), w);
+  }
+  if (X == nullptr) {
+    m_addend = wB;
+    return begin(bases.table(Base::G), x, nullptr, nullptr);
+  }
+  m_addend = X;
+  if (wB == nullptr) {
+    return begin(bases.table(base), w, nullptr, nullptr);
+  }
+
+  // both terms are precomputed: run() only adds them
+  m_tP = &bases.table(Base::G);
+  m_tQ = nullptr;
+  m_pos = 0;
+  m_acc = *wB;
+  return 0;
+}
+
+int
+Edwards25519Ops::beginKey(const uint8_t* peer, size_t peerLen, uint8_t* canonical,
+                          const mbedtls_mpi* x, Base base, const mbedtls_mpi* s,
+                          int (*)(void*, unsigned char*, size_t), void*) noexcept {
+  Point P;
+  {
+    SPAKE2_STATS_SCOPE(PointValidate);
+    if (peerLen != PointSize || !ptDecode(P, peer)) {
+      return MBEDTLS_ERR_ECP_INVALID_KEY;
+    }
+    std::copy_n(peer, PointSize, canonical);
+  }
+
+  m_addend = nullptr;
+  m_nDoubles = 3; // cofactor 8
+  int ret = begin(m_peerTable, x, &Bases::get().table(base), s);
+  if (ret == 0) {
+    // the table is filled by run(), within its budget
+    m_peer = P;
+    m_hasPeer = true;
+  }
+  clearPoint(P);
+  return ret;
+}
+
+int
+Edwards25519Ops::run(unsigned maxOps) noexcept {
+  if (m_tP == nullptr) {
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+
+  unsigned budget = maxOps;
+  bool spent = false;
+  if (m_hasPeer) {
+    makeTable(m_peerTable, m_peer);
+    clearPoint(m_peer);
+    m_hasPeer = false;
+    budget -= std::min<unsigned>(budget, OpsPerTable);
+    spent = true;
+  }
+
+  // at least one window, unless the table has used the budget
+  unsigned nWindows = maxOps == 0 ? m_pos : budget / OpsPerWindow;
+  if (!spent) {
+    nWindows = std::max(1U, nWindows);
+  }
+  nWindows = std::min<unsigned>(nWindows, m_pos);
+  runWindows(m_acc, *m_tP, m_m, m_tQ, m_n, m_pos, nWindows);
+  m_pos -= nWindows;
+  if (m_pos > 0) {
+    return MBEDTLS_ERR_ECP_IN_PROGRESS;
+  }
+
+  for (; m_nDoubles > 0; --m_nDoubles) {
+    ptDouble(m_acc, m_acc);
+  }
+  if (m_addend != nullptr) {
+    Cached C;
+    ptToCached(C, *m_addend);
+    ptAdd(m_acc, m_acc, C);
+    m_addend = nullptr;
+  }
+
+  // keep the result in m_acc, wipe everything else
+  m_tP = nullptr;
+  m_tQ = nullptr;
+  mbedtls_platform_zeroize(m_m, sizeof(m_m));
+  mbedtls_platform_zeroize(m_n, sizeof(m_n));
+  mbedtls_platform_zeroize(m_peerTable.data(), sizeof(m_peerTable));
+  return 0;
+}
+
+int
+Edwards25519Ops::normalize(Edwards25519Ops* const* ops, size_t n) noexcept {
+  // Montgomery's trick, see JointMul::normalize(); Z is never zero in extended coordinates
+  Fe prefix[NormalizeChunk];
+  while (n > 0) {
+    size_t m = std::min<size_t>(n, NormalizeChunk);
+    prefix[0] = ops[0]->m_acc.Z;
+    for (size_t i = 1; i < m; ++i) {
+      feMul(prefix[i], prefix[i - 1], ops[i]->m_acc.Z);
+    }
+
+    Fe inv, zInv;
+    feInvert(inv, prefix[m - 1]);
+    for (size_t i = m - 1; i > 0; --i) {
+      Point& P = ops[i]->m_acc;
+      feMul(zInv, inv, prefix[i - 1]);
+      feMul(inv, inv, P.Z);
+      ptScale(P, zInv);
+    }
+    ptScale(ops[0]->m_acc, inv);
+
+    ops += m;
+    n -= m;
+  }
+  mbedtls_platform_zeroize(prefix, sizeof(prefix));
+  return 0;
+}
+
+int
+Edwards25519Ops::writeResult(uint8_t* out, size_t len) noexcept {
+  if (len != PointSize) {
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+  // neutral element has x = 0 and y = 1
+  Fe zero;
+  feSub(zero, m_acc.Y, m_acc.Z);
+  if (feIsZero(m_acc.X) && feIsZero(zero)) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+  ptEncode(out, m_acc);
+  return 0;
+}
+
+void
+Edwards25519Ops::clear() noexcept {
+  m_tP = nullptr;
+  m_tQ = nullptr;
+  m_addend = nullptr;
+  m_pos = 0;
+  m_nDoubles = 0;
+  m_hasPeer = false;
+  clearPoint(m_peer);
+  mbedtls_platform_zeroize(m_m, sizeof(m_m));
+  mbedtls_platform_zeroize(m_n, sizeof(m_n));
+  mbedtls_platform_zeroize(m_peerTable.data(), sizeof(m_peerTable));
+  clearPoint(m_acc);
+}
+
+} // namespace detail
+
+const uint8_t Edwards25519::M[] = {
+  0xd0, 0x48, 0x03, 0x2c, 0x6e, 0xa0, 0xb6, 0xd6, 0x97, 0xdd, 0xc2, 0xe8, 0x6b, 0xda, 0x85, 0xa3,
+  0x3a, 0xda, 0xc9, 0x20, 0xf1, 0xbf, 0x18, 0xe1, 0xb0, 0xc6, 0xd1, 0x66, 0xa5, 0xce, 0xcd, 0xaf,
+};
+const uint8_t Edwards25519::N[] = {
+  0xd3, 0xbf, 0xb5, 0x18, 0xf4, 0x4f, 0x34, 0x30, 0xf2, 0x9d, 0x0c, 0x92, 0xaf, 0x50, 0x38, 0x65,
+  0xa1, 0xed, 0x32, 0x81, 0xdc, 0x69, 0xb3, 0x5d, 0xd8, 0x68, 0xba, 0x85, 0xf8, 0x86, 0xc4, 0xab,
+};
+
+} // namespace spake2
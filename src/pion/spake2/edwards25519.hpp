@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_EDWARDS25519_HPP
+#define PION_SPAKE2_EDWARDS25519_HPP
+
+#include "mbedtls-wrappers.hpp"
+
+#include <mbedtls/platform_util.h>
+
+namespace spake2 {
+namespace detail {
+
+/**
+ * @brief Group operations of Context on edwards25519, with a dedicated field backend.
+ *
+ * mbedtls has no arithmetic on twisted Edwards curves. Field elements of GF(2^255 - 19) are kept
+ * in ten signed limbs of alternately 26 and 25 bits, so that all products fit in 64-bit integers
+ * on 32-bit microcontrollers. Points are kept in extended coordinates and added with the formulas
+ * of Hisil, Wong, Carter, and Dawson (2008), which are complete on this curve.
+ *
+ * Scalar multiplications process both scalars at once in signed 4-bit windows, with tables of
+ * 1*P to 8*P. Table entries are selected by scanning the whole table, so that the sequence of
+ * operations does not depend on the scalars.
+ *
+ * The interface is the same as WeierstrassOps.
+ */
+class Edwards25519Ops {
+public:
+  enum class Base {
+    G = 0,
+    M = 1,
+    N = 2,
+  };
+
+  enum {
+    /** @brief Points are encoded as in RFC 8032, which has no separate compressed format. */
+    PointSize = 32,
+    CompressedPointSize = 32,
+    ScalarSize = 32,
+    Windows = 64,
+    TableSize = 8,
+    /** @brief Cost of one window, with the weights used by JointMul. */
+    OpsPerWindow = 4 * 8 + 2 * 11,
+    /** @brief Cost of filling a table, with the weights used by JointMul. */
+    OpsPerTable = (TableSize - 1) * 11,
+    /** @brief Maximum number of points that share an inversion in normalize(). */
+    NormalizeChunk = 32,
+  };
+
+  /** @brief Element of GF(2^255 - 19). */
+  struct Fe {
+    int32_t v[10];
+  };
+
+  /** @brief Point in extended coordinates (X:Y:Z:T), where x = X/Z, y = Y/Z, and xy = T/Z. */
+  struct Point {
+    Fe X;
+    Fe Y;
+    Fe Z;
+    Fe T;
+  };
+
+  /** @brief Point prepared for addition, (Y+X, Y-X, 2d*T, 2*Z). */
+  struct Cached {
+    Fe YpX;
+    Fe YmX;
+    Fe T2d;
+    Fe Z2;
+  };
+
+  /** @brief Multiples 1*P to 8*P of a point. */
+  using Table = std::array<Cached, TableSize>;
+
+  /** @brief Return the group order. */
+  static const mbedtls_mpi* order() noexcept;
+
+  /** @brief Compute X = x * base. */
+  static int mulBase(Point& X, const mbedtls_mpi* x, int (*f_rng)(void*, unsigned char*, size_t),
+                     void* p_rng, Base base = Base::G) noexcept;
+
+  /**
+   * @brief Decode and validate a point.
+   * @return 0, or an error code if the point is invalid.
+   */
+  static int decodePoint(Point& P, const uint8_t* buf, size_t len) noexcept;
+
+  /**
+   * @brief Encode a point.
+   * @param len PointSize.
+   * @return 0, or an error code if the point is the neutral element.
+   */
+  static int encodePoint(uint8_t* out, size_t len, const Point& P) noexcept;
+
+  /** @brief Move @p src into @p dst, and wipe the previous value of @p dst . */
+  static void movePoint(Point& dst, Point& src) noexcept {
+    dst = src;
+    clearPoint(src);
+  }
+
+  /** @brief Wipe a point. */
+  static void clearPoint(Point& P) noexcept {
+    mbedtls_platform_zeroize(&P, sizeof(P));
+  }
+
+  /**
+   * @brief Start computing x * G + w * base, where either term may be precomputed.
+   * @param X precomputed x * G, or nullptr.
+   * @param wB precomputed w * base, or nullptr.
+   * @note Precomputed points must outlive the computation.
+   */
+  int beginShare(const mbedtls_mpi* x, Point* X, Base base, const mbedtls_mpi* w, Point* wB,
+                 int (*f_rng)(void*, unsigned char*, size_t), void* p_rng) noexcept;
+
+  /**
+   * @brief Start computing h * (x * P + s * base), where P is the peer's public share.
+   * @param peer encoded P.
+   * @param[out] canonical encoding of P, PointSize octets.
+   * @return 0, or an error code if P is invalid.
+   * @note The cofactor h is 8, so that a small-order component of P does not affect the result.
+   *       The table of P is filled by run(), within its budget.
+   */
+  int beginKey(const uint8_t* peer, size_t peerLen, uint8_t* canonical, const mbedtls_mpi* x,
+               Base base, const mbedtls_mpi* s, int (*f_rng)(void*, unsigned char*, size_t),
+               void* p_rng) noexcept;
+
+  /**
+   * @brief Continue the computation.
+   * @param maxOps budget in the units of mbedtls_ecp_set_max_ops(); 0 means unlimited.
+   * @return 0 if done, MBEDTLS_ERR_ECP_IN_PROGRESS if it must be resumed, or an error code.
+   */
+  int run(unsigned maxOps) noexcept;
+
+  /**
+   * @brief Convert the results of several completed computations to affine coordinates, sharing
+   *        one field inversion.
+   *
+   * This is optional: writeResult() normalizes a result that has not been normalized.
+   * @return 0.
+   */
+  static int normalize(Edwards25519Ops* const* ops, size_t n) noexcept;
+
+  /**
+   * @brief Encode the result.
+   * @return 0, or an error code if the result is the neutral element.
+   */
+  int writeResult(uint8_t* out, size_t len) noexcept;
+
+  /** @brief Abandon the computation and wipe intermediate values and the result. */
+  void clear() noexcept;
+
+private:
+  /** @brief Start computing m * P + n * Q, or m * P if @p tQ is null. */
+  int begin(const Table& tP, const mbedtls_mpi* m, const Table* tQ, const mbedtls_mpi* n) noexcept;
+
+private:
+  const Table* m_tP = nullptr;
+  const Table* m_tQ = nullptr;
+  const Point* m_addend = nullptr;
+  Table m_peerTable{};
+  Point m_acc{};
+  int8_t m_m[Windows]{}; // signed digits of m
+  int8_t m_n[Windows]{}; // signed digits of n
+  uint8_t m_pos = 0;     // number of windows remaining
+  uint8_t m_nDoubles = 0;
+  Point m_peer{}; // peer's share, until m_peerTable is filled
+  bool m_hasPeer = false;
+};
+
+} // namespace detail
+} // namespace spake2
+
+#endif // PION_SPAKE2_EDWARDS25519_HPP
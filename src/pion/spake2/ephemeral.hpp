@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_EPHEMERAL_HPP
+#define PION_SPAKE2_EPHEMERAL_HPP
+
+#include "random.hpp"
+
+namespace spake2 {
+
+/**
+ * @brief Bounded pool of precomputed ephemeral shares (x, X = x*G).
+ * @tparam Group SPAKE2 group.
+ * @tparam Capacity maximum number of shares kept in the pool.
+ *
+ * The random scalar x and its public share X depend neither on the password nor on the peer,
+ * so they can be computed ahead of time, e.g. while the application is waiting for packets.
+ * A Context that takes a share from the pool only needs to add w*M or w*N in
+ * generateFirstMessage().
+ *
+ * This class is not thread-safe. The pool belongs to the thread that owns the Random.
+ */
+template<typename Group, size_t Capacity>
+class EphemeralPool {
+public:
+  explicit EphemeralPool(Random& random) noexcept
+    : m_random(random) {}
+
+  EphemeralPool(const EphemeralPool&) = delete;
+  EphemeralPool& operator=(const EphemeralPool&) = delete;
+
+  /** @brief Return number of available shares. */
+  size_t size() const noexcept {
+    return m_size;
+  }
+
+  /**
+   * @brief Generate shares until the pool is full or @p limit shares have been generated.
+   * @return number of generated shares.
+   *
+   * Each share costs one fixed-base scalar multiplication.
+   */
+  size_t refill(size_t limit = 1) noexcept;
+
+  using Ops = typename Group::Ops;
+
+  /**
+   * @brief Move a share out of the pool.
+   * @param[out] x random scalar.
+   * @param[out] X public share x*G.
+   * @return whether success; false if the pool is empty.
+   */
+  bool take(mbedtls_mpi* x, typename Ops::Point& X) noexcept;
+
+private:
+  Random& m_random;
+
+  ndnph::mbedtls::Mpi m_x[Capacity];
+  typename Ops::Point m_X[Capacity];
+  size_t m_size = 0;
+};
+
+template<typename Group, size_t Capacity>
+size_t
+EphemeralPool<Group, Capacity>::refill(size_t limit) noexcept {
+  size_t n = 0;
+  for (; n < limit && m_size < Capacity; ++n) {
+    mbedtls_mpi* x = m_x[m_size];
+
+    // Generate random scalar x, as in Context::start()
+    ndnph::mbedtls::Mpi random;
+    // NOTE: generate 8 extra bytes to avoid bias in modulo operation
+    int ret = mbedtls_mpi_fill_random(random, Group::ScalarSize + 8, Random::rng, &m_random);
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+      break;
+    }
+    ret = mbedtls_mpi_mod_mpi(x, random, Ops::order());
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+      break;
+    }
+
+    // X = x * G
+    ret = Ops::mulBase(m_X[m_size], x, Random::rng, &m_random);
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+      break;
+    }
+
+    ++m_size;
+  }
+  return n;
+}
+
+template<typename Group, size_t Capacity>
+bool
+EphemeralPool<Group, Capacity>::take(mbedtls_mpi* x, typename Ops::Point& X) noexcept {
+  if (m_size == 0) {
+    return false;
+  }
+  --m_size;
+
+  mbedtls_mpi* slotX = m_x[m_size];
+
+  // Swap instead of copying, then wipe the previous values of the output parameters
+  mbedtls_mpi_swap(x, slotX);
+  mbedtls_mpi_free(slotX);
+  Ops::movePoint(X, m_X[m_size]);
+  return true;
+}
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_EPHEMERAL_HPP
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_FIXED_BASE_HPP
+#define PION_SPAKE2_FIXED_BASE_HPP
+
+#include "joint-mul.hpp"
+
+namespace spake2 {
+namespace detail {
+
+/**
+ * @brief Process-wide precomputed tables for the fixed SPAKE2 points G, M, and N.
+ *
+ * mbedtls caches a comb table for the base point inside the group object, and uses it whenever
+ * mbedtls_ecp_mul() is asked to multiply that base point. This class loads the curve once for
+ * each fixed point, with M and N substituted as the base point, and warms up the tables, so that
+ * every multiplication by G, M, or N becomes a table-driven fixed-base multiplication.
+ * It also keeps the JointMul comb tables of G, M, and N.
+ *
+ * The instance is created on first use and is read-only afterwards; it is shared by all
+ * contexts of the same Group.
+ */
+template<typename Group>
+class FixedBase {
+public:
+  enum class Base {
+    G = 0,
+    M = 1,
+    N = 2,
+  };
+
+  /** @brief Return the shared instance, building the tables on first use. */
+  static FixedBase& get() noexcept {
+    static FixedBase instance;
+    return instance;
+  }
+
+  /**
+   * @brief Return the EC group whose base point is @p base.
+   * @note All three groups have the same curve parameters, including the order N.
+   */
+  mbedtls_ecp_group* group(Base base = Base::G) noexcept {
+    return m_groups[static_cast<int>(base)];
+  }
+
+  /** @brief Return the JointMul comb table of @p base. */
+  const JointMul::Table& table(Base base) const noexcept {
+    return m_tables[static_cast<int>(base)];
+  }
+
+  /** @brief Compute R = m * base. */
+  int mul(Base base, mbedtls_ecp_point* R, const mbedtls_mpi* m,
+          int (*f_rng)(void*, unsigned char*, size_t), void* p_rng) noexcept {
+    mbedtls_ecp_group* grp = group(base);
+    return mbedtls_ecp_mul(grp, R, m, &grp->G, f_rng, p_rng);
+  }
+
+private:
+  FixedBase() noexcept;
+
+  ~FixedBase() noexcept;
+
+  /** @brief Deterministic "RNG" for multiplying public points by a public scalar. */
+  static int warmupRng(void*, unsigned char* output, size_t len) noexcept {
+    std::fill_n(output, len, 0x5A);
+    return 0;
+  }
+
+private:
+  mbed::Object<mbedtls_ecp_group, mbedtls_ecp_group_init, mbedtls_ecp_group_free> m_groups[3];
+  JointMul::Table m_tables[3];
+};
+
+template<typename Group>
+FixedBase<Group>::FixedBase() noexcept {
+  const uint8_t* const points[] = {nullptr, Group::M, Group::N};
+  ndnph::mbedtls::Mpi one{1};
+  JointMul jointMul;
+
+  for (int i = 0; i < 3; ++i) {
+    mbedtls_ecp_group* grp = m_groups[i];
+    int ret = mbedtls_ecp_group_load(grp, Group::Id);
+    assert(ret == 0);
+
+    if (points[i] != nullptr) {
+      // Replace the base point with M or N. Curve parameters loaded from read-only data (h == 1)
+      // are neither modified nor freed by mbedtls, so the group gets its own copy of the point.
+      ndnph::mbedtls::EcPoint P;
+      ret = mbedtls_ecp_point_read_binary(grp, P, points[i], Group::UncompressedPointSize);
+      assert(ret == 0);
+      if (grp->MBEDTLS_PRIVATE(h) == 1) {
+        mbedtls_ecp_point_init(&grp->G);
+      }
+      ret = mbedtls_ecp_copy(&grp->G, P);
+      assert(ret == 0);
+      // Detach the comb table of the standard generator, if the curve was loaded with a static
+      // table; mbedtls does not free static tables, so there is nothing to release here.
+      grp->MBEDTLS_PRIVATE(T) = nullptr;
+      grp->MBEDTLS_PRIVATE(T_size) = 0;
+    }
+
+    // Build the comb table now, so that the group is never modified after construction
+    ndnph::mbedtls::EcPoint R;
+    ret = mbedtls_ecp_mul(grp, R, one, &grp->G, warmupRng, nullptr);
+    assert(ret == 0);
+
+    ret = jointMul.makeTable(grp, m_tables[i], &grp->G);
+    assert(ret == 0);
+    (void)ret;
+  }
+}
+
+template<typename Group>
+FixedBase<Group>::~FixedBase() noexcept {
+  for (int i = 1; i < 3; ++i) {
+    mbedtls_ecp_group* grp = m_groups[i];
+    if (grp->MBEDTLS_PRIVATE(h) == 1) {
+      mbedtls_ecp_point_free(&grp->G);
+    }
+  }
+}
+
+} // namespace detail
+} // namespace spake2
+
+#endif // PION_SPAKE2_FIXED_BASE_HPP
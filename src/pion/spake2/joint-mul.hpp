@@ -0,0 +1,494 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_JOINT_MUL_HPP
+#define PION_SPAKE2_JOINT_MUL_HPP
+
+#include "mbedtls-wrappers.hpp"
+
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+namespace spake2 {
+namespace detail {
+
+/**
+ * @brief Constant-time double-scalar multiplication R = m * P + n * Q.
+ *
+ * This uses the comb method on both scalars at once, so that the doublings are shared, and every
+ * column performs the same sequence of field operations regardless of the scalar bits. Table
+ * entries are selected by scanning the whole table with mbedtls_mpi_safe_cond_assign(). Points are
+ * kept in homogeneous projective coordinates and added with the complete formulas of Renes,
+ * Costello, and Batina (2016) for a = -3, which have no exceptional cases. As in mbedtls, the
+ * accumulator is randomized to mask the timing variations of the underlying bignum arithmetic.
+ *
+ * Tables of fixed points can be computed once and shared; see FixedBase.
+ *
+ * @note This requires a short Weierstrass curve with a = -3 and prime order, such as the NIST
+ *       curves; mbedtls leaves A unset for these curves.
+ */
+class JointMul {
+public:
+  enum {
+    Teeth = 4,
+    TableSize = 1 << Teeth,
+    /** @brief Cost of one doubling, in the units of mbedtls_ecp_set_max_ops(). */
+    OpsPerDouble = 8,
+    /** @brief Cost of one addition, in the units of mbedtls_ecp_set_max_ops(). */
+    OpsPerAdd = 11,
+    /** @brief Cost of one column, in the units of mbedtls_ecp_set_max_ops(). */
+    OpsPerColumn = OpsPerDouble + 2 * OpsPerAdd,
+    /** @brief Maximum number of points that share an inversion in normalize(). */
+    NormalizeChunk = 32,
+  };
+
+  /**
+   * @brief Comb table of a point.
+   *
+   * Entry j is the sum of 2^(i*d) * P over the bits i set in j, where d is the number of columns.
+   */
+  class Table {
+  public:
+    const mbedtls_ecp_point* operator[](unsigned i) const noexcept {
+      return m_pts[i];
+    }
+
+    void clear() noexcept {
+      for (auto& pt : m_pts) {
+        mbedtls_ecp_point_free(pt);
+      }
+    }
+
+  private:
+    mbed::EcPoint m_pts[TableSize];
+    friend JointMul;
+  };
+
+  /**
+   * @brief Fill @p table with the comb table of @p P.
+   * @param P affine point, not at infinity.
+   */
+  int makeTable(mbedtls_ecp_group* grp, Table& table, const mbedtls_ecp_point* P) noexcept {
+    int ret = beginTable(grp, table, P);
+    while (ret == 0 && m_table != nullptr) {
+      ret = stepTable();
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Start filling @p table with the comb table of @p P.
+   * @param P affine point, not at infinity, copied.
+   *
+   * The table is filled by the next run() calls, within their budgets, before the columns of the
+   * computation started by begin(). Filling a table costs nearly as much as the columns.
+   */
+  int beginTable(mbedtls_ecp_group* grp, Table& table, const mbedtls_ecp_point* P) noexcept {
+    m_grp = grp;
+    m_table = &table;
+    m_tableStep = 0;
+    int ret = 0;
+    // homogeneous coordinates of the point at infinity are (0:1:0)
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&table.m_pts[0]->X, 0));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&table.m_pts[0]->Y, 1));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&table.m_pts[0]->Z, 0));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_copy(table.m_pts[1], P));
+  cleanup:
+    if (ret != 0) {
+      m_table = nullptr;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Start computing m * P + n * Q.
+   * @param tP comb table of P, which must outlive the computation.
+   * @param tQ comb table of Q, which must outlive the computation.
+   * @param m scalar in [0, N), copied.
+   * @param n scalar in [0, N), copied.
+   */
+  int begin(mbedtls_ecp_group* grp, const Table& tP, const mbedtls_mpi* m, const Table& tQ,
+            const mbedtls_mpi* n, int (*f_rng)(void*, unsigned char*, size_t),
+            void* p_rng) noexcept {
+    m_grp = grp;
+    m_tP = &tP;
+    m_tQ = &tQ;
+    m_pos = columns(grp);
+
+    int ret = 0;
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(m_m, m));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(m_n, n));
+
+    // accumulator starts at infinity, (0:l:0) with random l in [2, p-1]
+    do {
+      MBEDTLS_MPI_CHK(mbedtls_mpi_fill_random(&m_acc->Y, (grp->pbits + 7) / 8, f_rng, p_rng));
+      MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&m_acc->Y, &m_acc->Y, &grp->P));
+    } while (mbedtls_mpi_cmp_int(&m_acc->Y, 1) <= 0);
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&m_acc->X, 0));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&m_acc->Z, 0));
+  cleanup:
+    return ret;
+  }
+
+  /**
+   * @brief Continue the computation started by begin().
+   * @param R result in homogeneous projective coordinates, which may be converted with
+   *          normalize(); only written when the computation is done.
+   * @param maxOps budget in the units of mbedtls_ecp_set_max_ops(); 0 means unlimited.
+   * @return 0 if done, MBEDTLS_ERR_ECP_IN_PROGRESS if it must be resumed, or an error code.
+   */
+  int run(mbedtls_ecp_point* R, unsigned maxOps) noexcept {
+    unsigned budget = maxOps;
+    bool spent = false;
+    unsigned nColumns = 0;
+    int ret = 0;
+    while (m_table != nullptr) {
+      unsigned cost = tableStepCost();
+      if (maxOps > 0 && spent && budget < cost) {
+        return MBEDTLS_ERR_ECP_IN_PROGRESS;
+      }
+      MBEDTLS_MPI_CHK(stepTable());
+      budget -= std::min(budget, cost);
+      spent = true;
+    }
+
+    // at least one column, unless the table has used the budget
+    nColumns = maxOps == 0 ? m_pos : budget / OpsPerColumn;
+    if (!spent) {
+      nColumns = std::max(1U, nColumns);
+    }
+    for (; m_pos > 0 && nColumns > 0; --nColumns) {
+      --m_pos;
+      MBEDTLS_MPI_CHK(dbl(m_acc, m_acc));
+      MBEDTLS_MPI_CHK(select(m_T, *m_tP, comb(m_m, m_pos)));
+      MBEDTLS_MPI_CHK(add(m_acc, m_acc, m_T));
+      MBEDTLS_MPI_CHK(select(m_T, *m_tQ, comb(m_n, m_pos)));
+      MBEDTLS_MPI_CHK(add(m_acc, m_acc, m_T));
+    }
+    if (m_pos > 0) {
+      return MBEDTLS_ERR_ECP_IN_PROGRESS;
+    }
+
+    mbedtls_mpi_swap(&R->X, &m_acc->X);
+    mbedtls_mpi_swap(&R->Y, &m_acc->Y);
+    mbedtls_mpi_swap(&R->Z, &m_acc->Z);
+  cleanup:
+    clear();
+    return ret;
+  }
+
+  /**
+   * @brief Convert points from homogeneous projective to affine coordinates.
+   * @param pts points; those at infinity or already affine (Z = 1) are left unchanged.
+   *
+   * The points share one modular inversion (Montgomery's trick): the inverse of the product of
+   * all Z is computed once, and the individual inverses are peeled off in a backward pass over the
+   * prefix products, at the cost of three multiplications per point.
+   */
+  int normalize(mbedtls_ecp_group* grp, mbedtls_ecp_point* const* pts, size_t n) noexcept {
+    m_grp = grp;
+    int ret = 0;
+    mbed::Mpi prefix[NormalizeChunk];
+    mbedtls_ecp_point* todo[NormalizeChunk];
+    while (n > 0) {
+      size_t m = 0;
+      for (; n > 0 && m < NormalizeChunk; --n, ++pts) {
+        mbedtls_ecp_point* P = *pts;
+        if (mbedtls_mpi_cmp_int(&P->Z, 0) == 0 || mbedtls_mpi_cmp_int(&P->Z, 1) == 0) {
+          continue;
+        }
+        todo[m] = P;
+        if (m == 0) {
+          MBEDTLS_MPI_CHK(mbedtls_mpi_copy(prefix[0], &P->Z));
+        } else {
+          MBEDTLS_MPI_CHK(mul(prefix[m], prefix[m - 1], &P->Z));
+        }
+        ++m;
+      }
+      if (m == 0) {
+        continue;
+      }
+
+      mbedtls_mpi* inv = m_t[0];
+      mbedtls_mpi* zInv = m_t[1];
+      MBEDTLS_MPI_CHK(mbedtls_mpi_inv_mod(inv, prefix[m - 1], &m_grp->P));
+      for (size_t i = m; i-- > 0;) {
+        mbedtls_ecp_point* P = todo[i];
+        if (i == 0) {
+          mbedtls_mpi_swap(zInv, inv);
+        } else {
+          MBEDTLS_MPI_CHK(mul(zInv, inv, prefix[i - 1]));
+          MBEDTLS_MPI_CHK(mul(inv, inv, &P->Z));
+        }
+        MBEDTLS_MPI_CHK(mul(&P->X, &P->X, zInv));
+        MBEDTLS_MPI_CHK(mul(&P->Y, &P->Y, zInv));
+        MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&P->Z, 1));
+      }
+    }
+  cleanup:
+    mbedtls_mpi_free(m_t[0]);
+    mbedtls_mpi_free(m_t[1]);
+    mbedtls_mpi_free(m_product);
+    return ret;
+  }
+
+  /** @brief Wipe intermediate values. */
+  void clear() noexcept {
+    m_pos = 0;
+    m_table = nullptr;
+    m_tableStep = 0;
+    for (mbedtls_mpi* x : {&m_acc->X, &m_acc->Y, &m_acc->Z, &m_T->X, &m_T->Y, &m_T->Z,
+                           static_cast<mbedtls_mpi*>(m_m), static_cast<mbedtls_mpi*>(m_n)}) {
+      mbedtls_mpi_free(x);
+    }
+    for (auto& t : m_t) {
+      mbedtls_mpi_free(t);
+    }
+    mbedtls_mpi_free(m_product);
+  }
+
+private:
+  static unsigned columns(const mbedtls_ecp_group* grp) noexcept {
+    return (grp->nbits + Teeth - 1) / Teeth;
+  }
+
+  /** @brief Return the cost of the next step of filling the table. */
+  unsigned tableStepCost() const noexcept {
+    return m_tableStep < (Teeth - 1) * columns(m_grp) ? OpsPerDouble : OpsPerAdd;
+  }
+
+  /**
+   * @brief Perform the next step of filling the table: one doubling or one addition.
+   *
+   * Steps are the d doublings that compute each table[2^i] = 2^(i*d) * P, then the additions
+   * that compute the other entries.
+   */
+  int stepTable() noexcept {
+    Table& table = *m_table;
+    unsigned d = columns(m_grp);
+    unsigned step = m_tableStep++;
+    int ret = 0;
+    if (step < (Teeth - 1) * d) {
+      unsigned i = 1 + step / d;
+      mbedtls_ecp_point* T = table.m_pts[1 << i];
+      MBEDTLS_MPI_CHK(dbl(T, step % d == 0 ? table.m_pts[1 << (i - 1)] : T));
+      return 0;
+    }
+
+    {
+      // the k-th entry whose index is not a power of two, from entry 3
+      unsigned k = step - (Teeth - 1) * d;
+      unsigned j = 3;
+      for (; (j & (j - 1)) == 0 || k > 0; ++j) {
+        if ((j & (j - 1)) != 0) {
+          --k;
+        }
+      }
+      unsigned low = j & (~j + 1);
+      MBEDTLS_MPI_CHK(add(table.m_pts[j], table.m_pts[j - low], table.m_pts[low]));
+      if (j == TableSize - 1) {
+        m_table = nullptr;
+      }
+    }
+  cleanup:
+    if (ret != 0) {
+      m_table = nullptr;
+    }
+    return ret;
+  }
+
+  /** @brief Gather the bits of @p k in column @p col. */
+  unsigned comb(const mbedtls_mpi* k, unsigned col) const noexcept {
+    unsigned d = columns(m_grp);
+    unsigned j = 0;
+    for (unsigned i = 0; i < Teeth; ++i) {
+      j |= static_cast<unsigned>(mbedtls_mpi_get_bit(k, i * d + col)) << i;
+    }
+    return j;
+  }
+
+  /** @brief R = table[d], reading every entry. */
+  static int select(mbedtls_ecp_point* R, const Table& table, unsigned d) noexcept {
+    int ret = 0;
+    for (unsigned i = 0; i < TableSize; ++i) {
+      // 1 if i == d, 0 otherwise, without branches
+      unsigned char eq = static_cast<unsigned char>(((i ^ d) - 1) >> (sizeof(unsigned) * 8 - 1));
+      MBEDTLS_MPI_CHK(mbedtls_mpi_safe_cond_assign(&R->X, &table[i]->X, eq));
+      MBEDTLS_MPI_CHK(mbedtls_mpi_safe_cond_assign(&R->Y, &table[i]->Y, eq));
+      MBEDTLS_MPI_CHK(mbedtls_mpi_safe_cond_assign(&R->Z, &table[i]->Z, eq));
+    }
+  cleanup:
+    return ret;
+  }
+
+  /** @brief Reduce modulo p, using the fast reduction of the curve if available. */
+  int reduce(mbedtls_mpi* x) noexcept {
+    auto modp = m_grp->MBEDTLS_PRIVATE(modp);
+    if (modp == nullptr) {
+      return mbedtls_mpi_mod_mpi(x, x, &m_grp->P);
+    }
+    int ret = 0;
+    MBEDTLS_MPI_CHK(modp(x));
+    while (mbedtls_mpi_cmp_int(x, 0) < 0) {
+      MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(x, x, &m_grp->P));
+    }
+    while (mbedtls_mpi_cmp_mpi(x, &m_grp->P) >= 0) {
+      MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(x, x, &m_grp->P));
+    }
+  cleanup:
+    return ret;
+  }
+
+  int mul(mbedtls_mpi* x, const mbedtls_mpi* a, const mbedtls_mpi* b) noexcept {
+    // mbedtls_mpi_mul_mpi() allocates a copy of an operand that aliases the output
+    int ret = mbedtls_mpi_mul_mpi(m_product, a, b);
+    if (ret == 0) {
+      ret = reduce(m_product);
+    }
+    if (ret == 0) {
+      mbedtls_mpi_swap(x, m_product);
+    }
+    return ret;
+  }
+
+  int add(mbedtls_mpi* x, const mbedtls_mpi* a, const mbedtls_mpi* b) noexcept {
+    int ret = mbedtls_mpi_add_mpi(x, a, b);
+    if (ret == 0 && mbedtls_mpi_cmp_mpi(x, &m_grp->P) >= 0) {
+      ret = mbedtls_mpi_sub_mpi(x, x, &m_grp->P);
+    }
+    return ret;
+  }
+
+  int sub(mbedtls_mpi* x, const mbedtls_mpi* a, const mbedtls_mpi* b) noexcept {
+    int ret = mbedtls_mpi_sub_mpi(x, a, b);
+    if (ret == 0 && mbedtls_mpi_cmp_int(x, 0) < 0) {
+      ret = mbedtls_mpi_add_mpi(x, x, &m_grp->P);
+    }
+    return ret;
+  }
+
+  /** @brief R = P + Q, complete addition (RCB16 algorithm 4). R may alias P or Q. */
+  int add(mbedtls_ecp_point* R, const mbedtls_ecp_point* P, const mbedtls_ecp_point* Q) noexcept {
+    const mbedtls_mpi* b = &m_grp->B;
+    const mbedtls_mpi *X1 = &P->X, *Y1 = &P->Y, *Z1 = &P->Z;
+    const mbedtls_mpi *X2 = &Q->X, *Y2 = &Q->Y, *Z2 = &Q->Z;
+    mbedtls_mpi *t0 = m_t[0], *t1 = m_t[1], *t2 = m_t[2], *t3 = m_t[3], *t4 = m_t[4];
+    mbedtls_mpi *X3 = m_t[5], *Y3 = m_t[6], *Z3 = m_t[7];
+    int ret = 0;
+    MBEDTLS_MPI_CHK(mul(t0, X1, X2));
+    MBEDTLS_MPI_CHK(mul(t1, Y1, Y2));
+    MBEDTLS_MPI_CHK(mul(t2, Z1, Z2));
+    MBEDTLS_MPI_CHK(add(t3, X1, Y1));
+    MBEDTLS_MPI_CHK(add(t4, X2, Y2));
+    MBEDTLS_MPI_CHK(mul(t3, t3, t4));
+    MBEDTLS_MPI_CHK(add(t4, t0, t1));
+    MBEDTLS_MPI_CHK(sub(t3, t3, t4));
+    MBEDTLS_MPI_CHK(add(t4, Y1, Z1));
+    MBEDTLS_MPI_CHK(add(X3, Y2, Z2));
+    MBEDTLS_MPI_CHK(mul(t4, t4, X3));
+    MBEDTLS_MPI_CHK(add(X3, t1, t2));
+    MBEDTLS_MPI_CHK(sub(t4, t4, X3));
+    MBEDTLS_MPI_CHK(add(X3, X1, Z1));
+    MBEDTLS_MPI_CHK(add(Y3, X2, Z2));
+    MBEDTLS_MPI_CHK(mul(X3, X3, Y3));
+    MBEDTLS_MPI_CHK(add(Y3, t0, t2));
+    MBEDTLS_MPI_CHK(sub(Y3, X3, Y3));
+    MBEDTLS_MPI_CHK(mul(Z3, b, t2));
+    MBEDTLS_MPI_CHK(sub(X3, Y3, Z3));
+    MBEDTLS_MPI_CHK(add(Z3, X3, X3));
+    MBEDTLS_MPI_CHK(add(X3, X3, Z3));
+    MBEDTLS_MPI_CHK(sub(Z3, t1, X3));
+    MBEDTLS_MPI_CHK(add(X3, t1, X3));
+    MBEDTLS_MPI_CHK(mul(Y3, b, Y3));
+    MBEDTLS_MPI_CHK(add(t1, t2, t2));
+    MBEDTLS_MPI_CHK(add(t2, t1, t2));
+    MBEDTLS_MPI_CHK(sub(Y3, Y3, t2));
+    MBEDTLS_MPI_CHK(sub(Y3, Y3, t0));
+    MBEDTLS_MPI_CHK(add(t1, Y3, Y3));
+    MBEDTLS_MPI_CHK(add(Y3, t1, Y3));
+    MBEDTLS_MPI_CHK(add(t1, t0, t0));
+    MBEDTLS_MPI_CHK(add(t0, t1, t0));
+    MBEDTLS_MPI_CHK(sub(t0, t0, t2));
+    MBEDTLS_MPI_CHK(mul(t1, t4, Y3));
+    MBEDTLS_MPI_CHK(mul(t2, t0, Y3));
+    MBEDTLS_MPI_CHK(mul(Y3, X3, Z3));
+    MBEDTLS_MPI_CHK(add(Y3, Y3, t2));
+    MBEDTLS_MPI_CHK(mul(X3, t3, X3));
+    MBEDTLS_MPI_CHK(sub(X3, X3, t1));
+    MBEDTLS_MPI_CHK(mul(Z3, t4, Z3));
+    MBEDTLS_MPI_CHK(mul(t1, t3, t0));
+    MBEDTLS_MPI_CHK(add(Z3, Z3, t1));
+    mbedtls_mpi_swap(&R->X, X3);
+    mbedtls_mpi_swap(&R->Y, Y3);
+    mbedtls_mpi_swap(&R->Z, Z3);
+  cleanup:
+    return ret;
+  }
+
+  /** @brief R = 2 * P, complete doubling (RCB16 algorithm 6). R may alias P. */
+  int dbl(mbedtls_ecp_point* R, const mbedtls_ecp_point* P) noexcept {
+    const mbedtls_mpi* b = &m_grp->B;
+    const mbedtls_mpi *X = &P->X, *Y = &P->Y, *Z = &P->Z;
+    mbedtls_mpi *t0 = m_t[0], *t1 = m_t[1], *t2 = m_t[2], *t3 = m_t[3];
+    mbedtls_mpi *X3 = m_t[5], *Y3 = m_t[6], *Z3 = m_t[7];
+    int ret = 0;
+    MBEDTLS_MPI_CHK(mul(t0, X, X));
+    MBEDTLS_MPI_CHK(mul(t1, Y, Y));
+    MBEDTLS_MPI_CHK(mul(t2, Z, Z));
+    MBEDTLS_MPI_CHK(mul(t3, X, Y));
+    MBEDTLS_MPI_CHK(add(t3, t3, t3));
+    MBEDTLS_MPI_CHK(mul(Z3, X, Z));
+    MBEDTLS_MPI_CHK(add(Z3, Z3, Z3));
+    MBEDTLS_MPI_CHK(mul(Y3, b, t2));
+    MBEDTLS_MPI_CHK(sub(Y3, Y3, Z3));
+    MBEDTLS_MPI_CHK(add(X3, Y3, Y3));
+    MBEDTLS_MPI_CHK(add(Y3, X3, Y3));
+    MBEDTLS_MPI_CHK(sub(X3, t1, Y3));
+    MBEDTLS_MPI_CHK(add(Y3, t1, Y3));
+    MBEDTLS_MPI_CHK(mul(Y3, X3, Y3));
+    MBEDTLS_MPI_CHK(mul(X3, X3, t3));
+    MBEDTLS_MPI_CHK(add(t3, t2, t2));
+    MBEDTLS_MPI_CHK(add(t2, t2, t3));
+    MBEDTLS_MPI_CHK(mul(Z3, b, Z3));
+    MBEDTLS_MPI_CHK(sub(Z3, Z3, t2));
+    MBEDTLS_MPI_CHK(sub(Z3, Z3, t0));
+    MBEDTLS_MPI_CHK(add(t3, Z3, Z3));
+    MBEDTLS_MPI_CHK(add(Z3, Z3, t3));
+    MBEDTLS_MPI_CHK(add(t3, t0, t0));
+    MBEDTLS_MPI_CHK(add(t0, t3, t0));
+    MBEDTLS_MPI_CHK(sub(t0, t0, t2));
+    MBEDTLS_MPI_CHK(mul(t0, t0, Z3));
+    MBEDTLS_MPI_CHK(add(Y3, Y3, t0));
+    MBEDTLS_MPI_CHK(mul(t0, Y, Z));
+    MBEDTLS_MPI_CHK(add(t0, t0, t0));
+    MBEDTLS_MPI_CHK(mul(Z3, t0, Z3));
+    MBEDTLS_MPI_CHK(sub(X3, X3, Z3));
+    MBEDTLS_MPI_CHK(mul(Z3, t0, t1));
+    MBEDTLS_MPI_CHK(add(Z3, Z3, Z3));
+    MBEDTLS_MPI_CHK(add(Z3, Z3, Z3));
+    mbedtls_mpi_swap(&R->X, X3);
+    mbedtls_mpi_swap(&R->Y, Y3);
+    mbedtls_mpi_swap(&R->Z, Z3);
+  cleanup:
+    return ret;
+  }
+
+private:
+  mbedtls_ecp_group* m_grp = nullptr;
+  const Table* m_tP = nullptr;
+  const Table* m_tQ = nullptr;
+  unsigned m_pos = 0; // number of columns remaining
+  Table* m_table = nullptr; // table being filled
+  unsigned m_tableStep = 0;
+  mbed::Mpi m_m;
+  mbed::Mpi m_n;
+  mbed::EcPoint m_acc;
+  mbed::EcPoint m_T;
+  mbed::Mpi m_t[8]; // scratch for field arithmetic
+  mbed::Mpi m_product;
+};
+
+} // namespace detail
+} // namespace spake2
+
+#endif // PION_SPAKE2_JOINT_MUL_HPP
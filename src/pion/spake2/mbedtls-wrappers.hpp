@@ -4,7 +4,22 @@
 #define SPAKE2_MBED_MBEDTLS_WRAPPERS_HPP
 
 #include "../common.hpp"
+#include <mbedtls/bignum.h>
+#include <mbedtls/ecp.h>
 #include <mbedtls/entropy.h>
+#include <mbedtls/md.h>
+
+#ifdef SPAKE2_DEBUG
+#include <iostream>
+#define SPAKE2_MBED_ERR(x)                                                                         \
+  do {                                                                                             \
+    std::cerr << __FILE__ << ':' << __LINE__ << ": mbedtls error " << (x) << '\n';                 \
+  } while (false)
+#else
+#define SPAKE2_MBED_ERR(x)                                                                         \
+  do {                                                                                             \
+  } while (false)
+#endif
 
 namespace mbed {
 
@@ -37,6 +52,12 @@ private:
 
 using Entropy = Object<mbedtls_entropy_context, mbedtls_entropy_init, mbedtls_entropy_free>;
 
+using MdContext = Object<mbedtls_md_context_t, mbedtls_md_init, mbedtls_md_free>;
+
+using Mpi = Object<mbedtls_mpi, mbedtls_mpi_init, mbedtls_mpi_free>;
+
+using EcPoint = Object<mbedtls_ecp_point, mbedtls_ecp_point_init, mbedtls_ecp_point_free>;
+
 } // namespace mbed
 
 #endif // SPAKE2_MBED_MBEDTLS_WRAPPERS_HPP
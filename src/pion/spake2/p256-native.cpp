@@ -0,0 +1,764 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "spake2.hpp"
+
+#ifdef PION_SPAKE2_P256_NATIVE
+
+#ifndef __SIZEOF_INT128__
+#error PION_SPAKE2_P256_NATIVE requires a compiler with unsigned __int128
+#endif
+
+namespace spake2 {
+namespace detail {
+namespace {
+
+__extension__ typedef unsigned __int128 u128;
+
+using Fe = P256NativeOps::Fe;
+using Point = P256NativeOps::Point;
+using Table = P256NativeOps::Table;
+
+// p = 2^256 - 2^224 + 2^192 + 2^96 - 1
+const Fe P{{0xffffffffffffffff, 0x00000000ffffffff, 0x0000000000000000, 0xffffffff00000001}};
+// Montgomery form of 1, i.e. 2^256 mod p
+const Fe One{{0x0000000000000001, 0xffffffff00000000, 0xffffffffffffffff, 0x00000000fffffffe}};
+// Montgomery form of the curve coefficient b
+const Fe B{{0xd89cdf6229c4bddf, 0xacf005cd78843090, 0xe5a220abf7212ed6, 0xdc30061d04874834}};
+// 2^512 mod p, for conversion into Montgomery form
+const Fe R2{{0x0000000000000003, 0xfffffffbffffffff, 0xfffffffffffffffe, 0x00000004fffffffd}};
+// p - 2, exponent of inversion
+const Fe PMinus2{{0xfffffffffffffffd, 0x00000000ffffffff, 0x0000000000000000, 0xffffffff00000001}};
+// (p + 1) / 4, exponent of square root
+const Fe SqrtExp{{0x0000000000000000, 0x0000000040000000, 0x4000000000000000, 0x3fffffffc0000000}};
+
+// group order, big endian
+const uint8_t Order[]{
+  0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
+};
+
+// encoding of the base point
+const uint8_t G[]{
+  0x04, 0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4,
+  0x40, 0xf2, 0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8,
+  0x98, 0xc2, 0x96, 0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a,
+  0x7c, 0x0f, 0x9e, 0x16, 0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40,
+  0x68, 0x37, 0xbf, 0x51, 0xf5,
+};
+
+/**
+ * @brief h = t - p if that does not borrow beyond the fifth limb @p hi , otherwise h = t.
+ * @pre t < 2p.
+ */
+void
+feReduceOnce(Fe& h, const uint64_t t[4], uint64_t hi) {
+  uint64_t r[4];
+  uint64_t borrow = 0;
+  for (int i = 0; i < 4; ++i) {
+    u128 d = static_cast<u128>(t[i]) - P.v[i] - borrow;
+    r[i] = static_cast<uint64_t>(d);
+    borrow = static_cast<uint64_t>(d >> 64) & 1;
+  }
+  // all ones if hi < borrow, i.e. t < p
+  uint64_t keep = 0 - ((hi - borrow) >> 63);
+  for (int i = 0; i < 4; ++i) {
+    h.v[i] = (t[i] & keep) | (r[i] & ~keep);
+  }
+}
+
+void
+feAdd(Fe& h, const Fe& f, const Fe& g) {
+  uint64_t t[4];
+  uint64_t carry = 0;
+  for (int i = 0; i < 4; ++i) {
+    u128 s = static_cast<u128>(f.v[i]) + g.v[i] + carry;
+    t[i] = static_cast<uint64_t>(s);
+    carry = static_cast<uint64_t>(s >> 64);
+  }
+  feReduceOnce(h, t, carry);
+}
+
+void
+feSub(Fe& h, const Fe& f, const Fe& g) {
+  uint64_t t[4];
+  uint64_t borrow = 0;
+  for (int i = 0; i < 4; ++i) {
+    u128 d = static_cast<u128>(f.v[i]) - g.v[i] - borrow;
+    t[i] = static_cast<uint64_t>(d);
+    borrow = static_cast<uint64_t>(d >> 64) & 1;
+  }
+  // add p back if the subtraction borrowed
+  uint64_t mask = 0 - borrow;
+  uint64_t carry = 0;
+  for (int i = 0; i < 4; ++i) {
+    u128 s = static_cast<u128>(t[i]) + (P.v[i] & mask) + carry;
+    h.v[i] = static_cast<uint64_t>(s);
+    carry = static_cast<uint64_t>(s >> 64);
+  }
+}
+
+/** @brief h = f * g / 2^256 mod p, Montgomery multiplication. h may alias f or g. */
+void
+feMul(Fe& h, const Fe& f, const Fe& g) {
+  uint64_t t[6]{};
+  for (int i = 0; i < 4; ++i) {
+    // t += f[i] * g
+    u128 c = 0;
+    for (int j = 0; j < 4; ++j) {
+      c += static_cast<u128>(f.v[i]) * g.v[j] + t[j];
+      t[j] = static_cast<uint64_t>(c);
+      c >>= 64;
+    }
+    c += t[4];
+    t[4] = static_cast<uint64_t>(c);
+    t[5] = static_cast<uint64_t>(c >> 64);
+
+    // t = (t + m * p) / 2^64, where m = t[0] because -1/p = 1 mod 2^64
+    uint64_t m = t[0];
+    c = (static_cast<u128>(m) * P.v[0] + t[0]) >> 64;
+    for (int j = 1; j < 4; ++j) {
+      c += static_cast<u128>(m) * P.v[j] + t[j];
+      t[j - 1] = static_cast<uint64_t>(c);
+      c >>= 64;
+    }
+    c += t[4];
+    t[3] = static_cast<uint64_t>(c);
+    t[4] = t[5] + static_cast<uint64_t>(c >> 64);
+  }
+  feReduceOnce(h, t, t[4]);
+}
+
+void
+feSq(Fe& h, const Fe& f) {
+  feMul(h, f, f);
+}
+
+/** @brief h = f^e, where e is public. h may alias f. */
+void
+fePow(Fe& h, const Fe& f, const Fe& e) {
+  Fe base = f;
+  Fe r = One;
+  for (int i = 255; i >= 0; --i) {
+    feSq(r, r);
+    if (((e.v[i / 64] >> (i % 64)) & 1) != 0) {
+      feMul(r, r, base);
+    }
+  }
+  h = r;
+}
+
+bool
+feIsZero(const Fe& f) {
+  return (f.v[0] | f.v[1] | f.v[2] | f.v[3]) == 0;
+}
+
+bool
+feEqual(const Fe& f, const Fe& g) {
+  Fe d;
+  feSub(d, f, g);
+  return feIsZero(d);
+}
+
+/** @brief f = g if b == 1, unchanged if b == 0, without branches. */
+void
+feCmov(Fe& f, const Fe& g, uint64_t b) {
+  uint64_t mask = 0 - b;
+  for (int i = 0; i < 4; ++i) {
+    f.v[i] ^= (f.v[i] ^ g.v[i]) & mask;
+  }
+}
+
+/**
+ * @brief Decode a big endian integer into Montgomery form.
+ * @return whether the integer is below p.
+ */
+bool
+feFromBytes(Fe& h, const uint8_t s[32]) {
+  Fe t;
+  for (int i = 0; i < 4; ++i) {
+    uint64_t limb = 0;
+    for (int j = 0; j < 8; ++j) {
+      limb = (limb << 8) | s[32 - 8 * (i + 1) + j];
+    }
+    t.v[i] = limb;
+  }
+  for (int i = 3; i >= 0; --i) {
+    if (t.v[i] != P.v[i]) {
+      if (t.v[i] > P.v[i]) {
+        return false;
+      }
+      break;
+    }
+    if (i == 0) {
+      return false; // t == p
+    }
+  }
+  feMul(h, t, R2);
+  return true;
+}
+
+/** @brief Encode the element as a big endian integer. */
+void
+feToBytes(uint8_t s[32], const Fe& f) {
+  Fe t;
+  feMul(t, f, Fe{{1, 0, 0, 0}});
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 8; ++j) {
+      s[32 - 8 * (i + 1) + j] = static_cast<uint8_t>(t.v[i] >> (56 - 8 * j));
+    }
+  }
+}
+
+void
+ptIdentity(Point& P) {
+  P.X = Fe{};
+  P.Y = One;
+  P.Z = Fe{};
+}
+
+/** @brief R = P + Q, complete addition (RCB16 algorithm 4). R may alias P or Q. */
+void
+ptAdd(Point& R, const Point& P, const Point& Q) {
+  const Fe &X1 = P.X, &Y1 = P.Y, &Z1 = P.Z;
+  const Fe &X2 = Q.X, &Y2 = Q.Y, &Z2 = Q.Z;
+  Fe t0, t1, t2, t3, t4, X3, Y3, Z3;
+  feMul(t0, X1, X2);
+  feMul(t1, Y1, Y2);
+  feMul(t2, Z1, Z2);
+  feAdd(t3, X1, Y1);
+  feAdd(t4, X2, Y2);
+  feMul(t3, t3, t4);
+  feAdd(t4, t0, t1);
+  feSub(t3, t3, t4);
+  feAdd(t4, Y1, Z1);
+  feAdd(X3, Y2, Z2);
+  feMul(t4, t4, X3);
+  feAdd(X3, t1, t2);
+  feSub(t4, t4, X3);
+  feAdd(X3, X1, Z1);
+  feAdd(Y3, X2, Z2);
+  feMul(X3, X3, Y3);
+  feAdd(Y3, t0, t2);
+  feSub(Y3, X3, Y3);
+  feMul(Z3, B, t2);
+  feSub(X3, Y3, Z3);
+  feAdd(Z3, X3, X3);
+  feAdd(X3, X3, Z3);
+  feSub(Z3, t1, X3);
+  feAdd(X3, t1, X3);
+  feMul(Y3, B, Y3);
+  feAdd(t1, t2, t2);
+  feAdd(t2, t1, t2);
+  feSub(Y3, Y3, t2);
+  feSub(Y3, Y3, t0);
+  feAdd(t1, Y3, Y3);
+  feAdd(Y3, t1, Y3);
+  feAdd(t1, t0, t0);
+  feAdd(t0, t1, t0);
+  feSub(t0, t0, t2);
+  feMul(t1, t4, Y3);
+  feMul(t2, t0, Y3);
+  feMul(Y3, X3, Z3);
+  feAdd(Y3, Y3, t2);
+  feMul(X3, t3, X3);
+  feSub(X3, X3, t1);
+  feMul(Z3, t4, Z3);
+  feMul(t1, t3, t0);
+  feAdd(Z3, Z3, t1);
+  R.X = X3;
+  R.Y = Y3;
+  R.Z = Z3;
+}
+
+/** @brief R = 2 * P, complete doubling (RCB16 algorithm 6). R may alias P. */
+void
+ptDouble(Point& R, const Point& P) {
+  const Fe &X = P.X, &Y = P.Y, &Z = P.Z;
+  Fe t0, t1, t2, t3, X3, Y3, Z3;
+  feSq(t0, X);
+  feSq(t1, Y);
+  feSq(t2, Z);
+  feMul(t3, X, Y);
+  feAdd(t3, t3, t3);
+  feMul(Z3, X, Z);
+  feAdd(Z3, Z3, Z3);
+  feMul(Y3, B, t2);
+  feSub(Y3, Y3, Z3);
+  feAdd(X3, Y3, Y3);
+  feAdd(Y3, X3, Y3);
+  feSub(X3, t1, Y3);
+  feAdd(Y3, t1, Y3);
+  feMul(Y3, X3, Y3);
+  feMul(X3, X3, t3);
+  feAdd(t3, t2, t2);
+  feAdd(t2, t2, t3);
+  feMul(Z3, B, Z3);
+  feSub(Z3, Z3, t2);
+  feSub(Z3, Z3, t0);
+  feAdd(t3, Z3, Z3);
+  feAdd(Z3, Z3, t3);
+  feAdd(t3, t0, t0);
+  feAdd(t0, t3, t0);
+  feSub(t0, t0, t2);
+  feMul(t0, t0, Z3);
+  feAdd(Y3, Y3, t0);
+  feMul(t0, Y, Z);
+  feAdd(t0, t0, t0);
+  feMul(Z3, t0, Z3);
+  feSub(X3, X3, Z3);
+  feMul(Z3, t0, t1);
+  feAdd(Z3, Z3, Z3);
+  feAdd(Z3, Z3, Z3);
+  R.X = X3;
+  R.Y = Y3;
+  R.Z = Z3;
+}
+
+/** @brief Compute x^3 - 3x + b. */
+void
+curveRhs(Fe& h, const Fe& x) {
+  Fe x3, x3b;
+  feSq(x3, x);
+  feMul(x3, x3, x);
+  feAdd(x3b, x3, B);
+  Fe tx;
+  feAdd(tx, x, x);
+  feAdd(tx, tx, x);
+  feSub(h, x3b, tx);
+}
+
+/**
+ * @brief Decode a point in uncompressed or compressed SEC1 format.
+ * @return whether the encoding is valid and the point is on the curve.
+ */
+bool
+ptDecode(Point& P, const uint8_t* buf, size_t len) {
+  if (len == P256NativeOps::PointSize && buf[0] == 0x04) {
+    if (!feFromBytes(P.X, &buf[1]) || !feFromBytes(P.Y, &buf[33])) {
+      return false;
+    }
+    Fe rhs, y2;
+    curveRhs(rhs, P.X);
+    feSq(y2, P.Y);
+    if (!feEqual(rhs, y2)) {
+      return false;
+    }
+  } else if (len == P256NativeOps::CompressedPointSize && (buf[0] == 0x02 || buf[0] == 0x03)) {
+    if (!feFromBytes(P.X, &buf[1])) {
+      return false;
+    }
+    Fe rhs, y2;
+    curveRhs(rhs, P.X);
+    fePow(P.Y, rhs, SqrtExp);
+    feSq(y2, P.Y);
+    if (!feEqual(rhs, y2)) {
+      return false;
+    }
+    uint8_t y[32];
+    feToBytes(y, P.Y);
+    if ((y[31] & 1) != (buf[0] & 1)) {
+      feSub(P.Y, Fe{}, P.Y);
+    }
+  } else {
+    return false;
+  }
+  P.Z = One;
+  return true;
+}
+
+/** @brief Encode affine coordinates in uncompressed or compressed SEC1 format. */
+void
+encodeAffine(uint8_t* buf, size_t len, const Fe& x, const Fe& y) {
+  feToBytes(&buf[1], x);
+  if (len == P256NativeOps::PointSize) {
+    buf[0] = 0x04;
+    feToBytes(&buf[33], y);
+  } else {
+    uint8_t yb[32];
+    feToBytes(yb, y);
+    buf[0] = static_cast<uint8_t>(0x02 | (yb[31] & 1));
+  }
+}
+
+/**
+ * @brief Encode a point in uncompressed or compressed SEC1 format.
+ * @pre P is not the point at infinity.
+ */
+void
+ptEncode(uint8_t* buf, size_t len, const Point& P) {
+  Fe x = P.X, y = P.Y;
+  if (!feEqual(P.Z, One)) {
+    Fe zInv;
+    fePow(zInv, P.Z, PMinus2);
+    feMul(x, P.X, zInv);
+    feMul(y, P.Y, zInv);
+  }
+  encodeAffine(buf, len, x, y);
+}
+
+/** @brief Multiply X and Y by @p zInv = 1/Z, and set Z = 1. */
+void
+ptScale(Point& P, const Fe& zInv) {
+  feMul(P.X, P.X, zInv);
+  feMul(P.Y, P.Y, zInv);
+  P.Z = One;
+}
+
+/** @brief Start filling @p table with the comb table of @p P. */
+void
+beginTable(Table& table, const Point& P) {
+  ptIdentity(table[0]);
+  table[1] = P;
+}
+
+/** @brief Return the cost of a step of filling a table, with the weights used by JointMul. */
+unsigned
+tableStepCost(unsigned step) {
+  using Ops = P256NativeOps;
+  return step < (Ops::Teeth - 1) * Ops::Columns ? 8 : 11;
+}
+
+/**
+ * @brief Perform a step of filling a table: one doubling or one addition.
+ *
+ * Steps are the doublings that compute each table[2^i] = 2^(i*d) * P, then the additions that
+ * compute the other entries; see JointMul::stepTable().
+ */
+void
+stepTable(Table& table, unsigned step) {
+  using Ops = P256NativeOps;
+  if (step < (Ops::Teeth - 1) * Ops::Columns) {
+    unsigned i = 1 + step / Ops::Columns;
+    Point& T = table[1 << i];
+    ptDouble(T, step % Ops::Columns == 0 ? table[1 << (i - 1)] : T);
+    return;
+  }
+
+  // the k-th entry whose index is not a power of two, from entry 3
+  unsigned k = step - (Ops::Teeth - 1) * Ops::Columns;
+  unsigned j = 3;
+  for (; (j & (j - 1)) == 0 || k > 0; ++j) {
+    if ((j & (j - 1)) != 0) {
+      --k;
+    }
+  }
+  unsigned low = j & (~j + 1);
+  ptAdd(table[j], table[j - low], table[low]);
+}
+
+/** @brief Fill @p table with the comb table of @p P. */
+void
+makeTable(Table& table, const Point& P) {
+  beginTable(table, P);
+  for (unsigned step = 0; step < P256NativeOps::TableSteps; ++step) {
+    stepTable(table, step);
+  }
+}
+
+/** @brief R = table[d], reading every entry. */
+void
+select(Point& R, const Table& table, unsigned d) {
+  R = table[0];
+  for (unsigned i = 1; i < table.size(); ++i) {
+    // 1 if i == d, 0 otherwise, without branches
+    uint64_t eq = static_cast<uint64_t>(((i ^ d) - 1) >> (sizeof(unsigned) * 8 - 1));
+    feCmov(R.X, table[i].X, eq);
+    feCmov(R.Y, table[i].Y, eq);
+    feCmov(R.Z, table[i].Z, eq);
+  }
+}
+
+/** @brief Gather the bits of the little endian scalar @p k in column @p col. */
+unsigned
+comb(const uint8_t k[P256NativeOps::ScalarSize], unsigned col) {
+  unsigned j = 0;
+  for (unsigned i = 0; i < P256NativeOps::Teeth; ++i) {
+    unsigned bit = i * P256NativeOps::Columns + col;
+    j |= static_cast<unsigned>((k[bit / 8] >> (bit % 8)) & 1) << i;
+  }
+  return j;
+}
+
+/**
+ * @brief Write a scalar in little endian.
+ * @return 0, or an error code if the scalar does not fit.
+ */
+int
+writeScalar(uint8_t k[P256NativeOps::ScalarSize], const mbedtls_mpi* x) {
+  return mbedtls_mpi_write_binary_le(x, k, P256NativeOps::ScalarSize);
+}
+
+/** @brief Process columns [pos - nColumns, pos) of m * P + n * Q into the accumulator R. */
+void
+runColumns(Point& R, const Table& tP, const uint8_t* m, const Table* tQ, const uint8_t* n,
+           unsigned pos, unsigned nColumns) {
+  Point T;
+  for (; nColumns > 0; --nColumns) {
+    --pos;
+    ptDouble(R, R);
+    select(T, tP, comb(m, pos));
+    ptAdd(R, R, T);
+    if (tQ != nullptr) {
+      select(T, *tQ, comb(n, pos));
+      ptAdd(R, R, T);
+    }
+  }
+  mbedtls_platform_zeroize(&T, sizeof(T));
+}
+
+/** @brief Process-wide comb tables of G, M, and N, built on first use. */
+class Bases {
+public:
+  static const Bases& get() {
+    static Bases instance;
+    return instance;
+  }
+
+  const Table& table(P256NativeOps::Base base) const {
+    return m_tables[static_cast<int>(base)];
+  }
+
+  const mbedtls_mpi* order() const {
+    return m_order;
+  }
+
+private:
+  Bases() {
+    const uint8_t* const points[] = {G, P256::M, P256::N};
+    for (int i = 0; i < 3; ++i) {
+      Point P;
+      bool ok = ptDecode(P, points[i], P256NativeOps::PointSize);
+      assert(ok);
+      (void)ok;
+      makeTable(m_tables[i], P);
+    }
+
+    int ret = mbedtls_mpi_read_binary(m_order, Order, sizeof(Order));
+    assert(ret == 0);
+    (void)ret;
+  }
+
+private:
+  Table m_tables[3];
+  ndnph::mbedtls::Mpi m_order;
+};
+
+} // namespace
+
+const mbedtls_mpi*
+P256NativeOps::order() noexcept {
+  return Bases::get().order();
+}
+
+int
+P256NativeOps::mulBase(Point& X, const mbedtls_mpi* x, int (*)(void*, unsigned char*, size_t),
+                       void*, Base base) noexcept {
+  uint8_t k[ScalarSize];
+  int ret = writeScalar(k, x);
+  if (ret != 0) {
+    return ret;
+  }
+  ptIdentity(X);
+  runColumns(X, Bases::get().table(base), k, nullptr, nullptr, Columns, Columns);
+  mbedtls_platform_zeroize(k, sizeof(k));
+  return 0;
+}
+
+int
+P256NativeOps::decodePoint(Point& P, const uint8_t* buf, size_t len) noexcept {
+  if (!ptDecode(P, buf, len)) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+  return 0;
+}
+
+int
+P256NativeOps::encodePoint(uint8_t* out, size_t len, const Point& P) noexcept {
+  if (len != PointSize) {
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+  if (feIsZero(P.Z)) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+  ptEncode(out, len, P);
+  return 0;
+}
+
+int
+P256NativeOps::begin(const Table& tP, const mbedtls_mpi* m, const Table* tQ,
+                     const mbedtls_mpi* n) noexcept {
+  int ret = writeScalar(m_m, m);
+  if (ret == 0 && tQ != nullptr) {
+    ret = writeScalar(m_n, n);
+  }
+  if (ret != 0) {
+    clear();
+    return ret;
+  }
+  m_tP = &tP;
+  m_tQ = tQ;
+  m_pos = Columns;
+  m_tableStep = TableSteps;
+  ptIdentity(m_acc);
+  return 0;
+}
+
+int
+P256NativeOps::beginShare(const mbedtls_mpi* x, Point* X, Base base, const mbedtls_mpi* w,
+                          Point* wB, int (*)(void*, unsigned char*, size_t), void*) noexcept {
+  const Bases& bases = Bases::get();
+  if (X == nullptr && wB == nullptr) {
+    m_addend = nullptr;
+    return begin(bases.table(Base::G), x, &bases.table(base), w);
+  }
+  if (X == nullptr) {
+    m_addend = wB;
+    return begin(bases.table(Base::G), x, nullptr, nullptr);
+  }
+  m_addend = X;
+  if (wB == nullptr) {
+    return begin(bases.table(base), w, nullptr, nullptr);
+  }
+
+  // both terms are precomputed: run() only adds them
+  m_tP = &bases.table(Base::G);
+  m_tQ = nullptr;
+  m_pos = 0;
+  m_acc = *wB;
+  return 0;
+}
+
+int
+P256NativeOps::beginKey(const uint8_t* peer, size_t peerLen, uint8_t* canonical,
+                        const mbedtls_mpi* x, Base base, const mbedtls_mpi* s,
+                        int (*)(void*, unsigned char*, size_t), void*) noexcept {
+  Point P;
+  {
+    SPAKE2_STATS_SCOPE(PointValidate);
+    if (!ptDecode(P, peer, peerLen)) {
+      return MBEDTLS_ERR_ECP_INVALID_KEY;
+    }
+    encodeAffine(canonical, PointSize, P.X, P.Y); // Z is 1 after decoding
+  }
+
+  SPAKE2_STATS_SCOPE(ScalarMul);
+  beginTable(m_peerTable, P);
+
+  m_addend = nullptr;
+  int ret = begin(m_peerTable, x, &Bases::get().table(base), s);
+  if (ret == 0) {
+    m_tableStep = 0;
+  }
+  return ret;
+}
+
+int
+P256NativeOps::run(unsigned maxOps) noexcept {
+  if (m_tP == nullptr) {
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+
+  unsigned budget = maxOps;
+  bool spent = false;
+  for (; m_tableStep < TableSteps; ++m_tableStep) {
+    unsigned cost = tableStepCost(m_tableStep);
+    if (maxOps > 0 && spent && budget < cost) {
+      return MBEDTLS_ERR_ECP_IN_PROGRESS;
+    }
+    stepTable(m_peerTable, m_tableStep);
+    budget -= std::min(budget, cost);
+    spent = true;
+  }
+
+  // at least one column, unless the table has used the budget
+  unsigned nColumns = maxOps == 0 ? m_pos : budget / OpsPerColumn;
+  if (!spent) {
+    nColumns = std::max(1U, nColumns);
+  }
+  nColumns = std::min<unsigned>(nColumns, m_pos);
+  runColumns(m_acc, *m_tP, m_m, m_tQ, m_n, m_pos, nColumns);
+  m_pos -= nColumns;
+  if (m_pos > 0) {
+    return MBEDTLS_ERR_ECP_IN_PROGRESS;
+  }
+
+  if (m_addend != nullptr) {
+    ptAdd(m_acc, m_acc, *m_addend);
+    m_addend = nullptr;
+  }
+
+  // keep the result in m_acc, wipe everything else
+  m_tP = nullptr;
+  m_tQ = nullptr;
+  mbedtls_platform_zeroize(m_m, sizeof(m_m));
+  mbedtls_platform_zeroize(m_n, sizeof(m_n));
+  mbedtls_platform_zeroize(m_peerTable.data(), sizeof(m_peerTable));
+  return 0;
+}
+
+int
+P256NativeOps::normalize(P256NativeOps* const* ops, size_t n) noexcept {
+  // Montgomery's trick, see JointMul::normalize()
+  Fe prefix[NormalizeChunk];
+  Point* todo[NormalizeChunk];
+  while (n > 0) {
+    size_t m = 0;
+    for (; n > 0 && m < NormalizeChunk; --n, ++ops) {
+      Point& P = (*ops)->m_acc;
+      if (feIsZero(P.Z)) {
+        continue; // point at infinity, rejected by writeResult()
+      }
+      todo[m] = &P;
+      if (m == 0) {
+        prefix[0] = P.Z;
+      } else {
+        feMul(prefix[m], prefix[m - 1], P.Z);
+      }
+      ++m;
+    }
+    if (m == 0) {
+      continue;
+    }
+
+    Fe inv, zInv;
+    fePow(inv, prefix[m - 1], PMinus2);
+    for (size_t i = m - 1; i > 0; --i) {
+      feMul(zInv, inv, prefix[i - 1]);
+      feMul(inv, inv, todo[i]->Z);
+      ptScale(*todo[i], zInv);
+    }
+    ptScale(*todo[0], inv);
+  }
+  mbedtls_platform_zeroize(prefix, sizeof(prefix));
+  return 0;
+}
+
+int
+P256NativeOps::writeResult(uint8_t* out, size_t len) noexcept {
+  if (len != PointSize && len != CompressedPointSize) {
+    return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+  }
+  if (feIsZero(m_acc.Z)) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+  ptEncode(out, len, m_acc);
+  return 0;
+}
+
+void
+P256NativeOps::clear() noexcept {
+  m_tP = nullptr;
+  m_tQ = nullptr;
+  m_addend = nullptr;
+  m_pos = 0;
+  m_tableStep = TableSteps;
+  mbedtls_platform_zeroize(m_m, sizeof(m_m));
+  mbedtls_platform_zeroize(m_n, sizeof(m_n));
+  mbedtls_platform_zeroize(m_peerTable.data(), sizeof(m_peerTable));
+  clearPoint(m_acc);
+}
+
+} // namespace detail
+} // namespace spake2
+
+#endif // PION_SPAKE2_P256_NATIVE
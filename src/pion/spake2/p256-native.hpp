@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_P256_NATIVE_HPP
+#define PION_SPAKE2_P256_NATIVE_HPP
+
+#include "mbedtls-wrappers.hpp"
+
+#include <mbedtls/platform_util.h>
+
+namespace spake2 {
+namespace detail {
+
+/**
+ * @brief Group operations of Context on P-256, with native 64-bit arithmetic.
+ *
+ * This is an alternative to WeierstrassOps<P256> for hosts whose compiler has a 128-bit integer
+ * type. Field elements are kept in four 64-bit limbs in Montgomery form, so that the arithmetic
+ * neither allocates nor branches on secret data. The algorithms are the same as JointMul: a comb
+ * with 4 teeth on both scalars at once, and the complete formulas of Renes, Costello, and Batina
+ * (2016) for a = -3. Results are encoded exactly as mbedtls would encode them.
+ *
+ * This is compiled only if PION_SPAKE2_P256_NATIVE is defined.
+ * The interface is the same as WeierstrassOps.
+ */
+class P256NativeOps {
+public:
+  enum class Base {
+    G = 0,
+    M = 1,
+    N = 2,
+  };
+
+  enum {
+    PointSize = 65,
+    CompressedPointSize = 33,
+    ScalarSize = 32,
+    Teeth = 4,
+    TableSize = 1 << Teeth,
+    Columns = 64,
+    /** @brief Cost of one column, with the weights used by JointMul. */
+    OpsPerColumn = 8 + 2 * 11,
+    /** @brief Steps to fill a comb table: the doublings of each tooth, then the additions. */
+    TableSteps = (Teeth - 1) * Columns + TableSize - Teeth - 1,
+    /** @brief Maximum number of points that share an inversion in normalize(). */
+    NormalizeChunk = 32,
+  };
+
+  /** @brief Element of GF(p) in Montgomery form, least significant limb first. */
+  struct Fe {
+    uint64_t v[4];
+  };
+
+  /** @brief Point in homogeneous projective coordinates (X:Y:Z), where x = X/Z and y = Y/Z. */
+  struct Point {
+    Fe X;
+    Fe Y;
+    Fe Z;
+  };
+
+  /**
+   * @brief Comb table of a point.
+   *
+   * Entry j is the sum of 2^(i*Columns) * P over the bits i set in j.
+   */
+  using Table = std::array<Point, TableSize>;
+
+  /** @brief Return the group order. */
+  static const mbedtls_mpi* order() noexcept;
+
+  /** @brief Compute X = x * base. */
+  static int mulBase(Point& X, const mbedtls_mpi* x, int (*f_rng)(void*, unsigned char*, size_t),
+                     void* p_rng, Base base = Base::G) noexcept;
+
+  /**
+   * @brief Decode and validate a point.
+   * @param buf uncompressed or compressed encoding.
+   * @return 0, or an error code if the point is invalid.
+   */
+  static int decodePoint(Point& P, const uint8_t* buf, size_t len) noexcept;
+
+  /**
+   * @brief Encode a point in uncompressed format.
+   * @param len PointSize.
+   * @return 0, or an error code if the point is the point at infinity.
+   */
+  static int encodePoint(uint8_t* out, size_t len, const Point& P) noexcept;
+
+  /** @brief Move @p src into @p dst, and wipe the previous value of @p dst . */
+  static void movePoint(Point& dst, Point& src) noexcept {
+    dst = src;
+    clearPoint(src);
+  }
+
+  /** @brief Wipe a point. */
+  static void clearPoint(Point& P) noexcept {
+    mbedtls_platform_zeroize(&P, sizeof(P));
+  }
+
+  /**
+   * @brief Start computing x * G + w * base, where either term may be precomputed.
+   * @param X precomputed x * G, or nullptr.
+   * @param wB precomputed w * base, or nullptr.
+   * @note Precomputed points must outlive the computation.
+   */
+  int beginShare(const mbedtls_mpi* x, Point* X, Base base, const mbedtls_mpi* w, Point* wB,
+                 int (*f_rng)(void*, unsigned char*, size_t), void* p_rng) noexcept;
+
+  /**
+   * @brief Start computing h * (x * P + s * base), where P is the peer's public share.
+   * @param peer encoded P, uncompressed or compressed.
+   * @param[out] canonical uncompressed encoding of P, PointSize octets.
+   * @return 0, or an error code if P is invalid.
+   * @note The cofactor h is 1. The comb table of P is filled by run(), within its budget.
+   */
+  int beginKey(const uint8_t* peer, size_t peerLen, uint8_t* canonical, const mbedtls_mpi* x,
+               Base base, const mbedtls_mpi* s, int (*f_rng)(void*, unsigned char*, size_t),
+               void* p_rng) noexcept;
+
+  /**
+   * @brief Continue the computation.
+   * @param maxOps budget in the units of mbedtls_ecp_set_max_ops(); 0 means unlimited.
+   * @return 0 if done, MBEDTLS_ERR_ECP_IN_PROGRESS if it must be resumed, or an error code.
+   */
+  int run(unsigned maxOps) noexcept;
+
+  /**
+   * @brief Convert the results of several completed computations to affine coordinates, sharing
+   *        one field inversion.
+   *
+   * This is optional: writeResult() normalizes a result that has not been normalized.
+   * @return 0.
+   */
+  static int normalize(P256NativeOps* const* ops, size_t n) noexcept;
+
+  /**
+   * @brief Encode the result.
+   * @param len PointSize for the uncompressed format, or CompressedPointSize for the compressed
+   *            format.
+   * @return 0, or an error code if the result is the point at infinity.
+   */
+  int writeResult(uint8_t* out, size_t len) noexcept;
+
+  /** @brief Abandon the computation and wipe intermediate values and the result. */
+  void clear() noexcept;
+
+private:
+  /** @brief Start computing m * P + n * Q, or m * P if @p tQ is null. */
+  int begin(const Table& tP, const mbedtls_mpi* m, const Table* tQ, const mbedtls_mpi* n) noexcept;
+
+private:
+  const Table* m_tP = nullptr;
+  const Table* m_tQ = nullptr;
+  const Point* m_addend = nullptr;
+  Table m_peerTable{};
+  Point m_acc{};
+  uint8_t m_m[ScalarSize]{};        // m, little endian
+  uint8_t m_n[ScalarSize]{};        // n, little endian
+  uint8_t m_pos = 0;                // number of columns remaining
+  uint8_t m_tableStep = TableSteps; // next step of filling m_peerTable, TableSteps if filled
+};
+
+} // namespace detail
+} // namespace spake2
+
+#endif // PION_SPAKE2_P256_NATIVE_HPP
@@ -0,0 +1,89 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_POOL_HPP
+#define PION_SPAKE2_POOL_HPP
+
+#include "random.hpp"
+
+#include <memory>
+
+namespace spake2 {
+
+/**
+ * @brief Bounded pool of warm SPAKE2 contexts.
+ * @tparam Ctx a Context specialization.
+ * @tparam Capacity maximum number of idle contexts kept in the pool.
+ *
+ * A context released into the pool is reset and kept for the next acquire(), so that its digest
+ * and HMAC contexts, and the storage of its group tables, are reused instead of set up again. The
+ * DRBG is not part of a context: all contexts share the Random given to the pool. If the pool is
+ * empty, a new context is constructed; if the pool is full, a released context is destroyed.
+ *
+ * This class is not thread-safe. The pool must outlive all contexts acquired from it. The pool and
+ * its contexts belong to the thread that owns the Random.
+ */
+template<typename Ctx, size_t Capacity>
+class ContextPool {
+public:
+  class Deleter {
+  public:
+    explicit Deleter(ContextPool* pool = nullptr)
+      : m_pool(pool) {}
+
+    void operator()(Ctx* ctx) const noexcept {
+      if (m_pool == nullptr) {
+        delete ctx;
+      } else {
+        m_pool->release(ctx);
+      }
+    }
+
+  private:
+    ContextPool* m_pool;
+  };
+
+  /** @brief Borrowed context, returned to the pool when destroyed or reset. */
+  using Ptr = std::unique_ptr<Ctx, Deleter>;
+
+  explicit ContextPool(Random& random) noexcept
+    : m_random(random) {}
+
+  ~ContextPool() noexcept {
+    for (size_t i = 0; i < m_nIdle; ++i) {
+      delete m_idle[i];
+    }
+  }
+
+  ContextPool(const ContextPool&) = delete;
+  ContextPool& operator=(const ContextPool&) = delete;
+
+  /** @brief Borrow a context in the initial state. */
+  Ptr acquire() noexcept {
+    Ctx* ctx = m_nIdle > 0 ? m_idle[--m_nIdle] : new Ctx(m_random);
+    return Ptr(ctx, Deleter(this));
+  }
+
+  /** @brief Return number of idle contexts. */
+  size_t size() const noexcept {
+    return m_nIdle;
+  }
+
+private:
+  void release(Ctx* ctx) noexcept {
+    if (m_nIdle == Capacity) {
+      delete ctx;
+      return;
+    }
+    ctx->reset();
+    m_idle[m_nIdle++] = ctx;
+  }
+
+private:
+  Random& m_random;
+  Ctx* m_idle[Capacity];
+  size_t m_nIdle = 0;
+};
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_POOL_HPP
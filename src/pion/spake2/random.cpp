@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "random.hpp"
+
+namespace spake2 {
+
+bool
+Random::seed() noexcept {
+  if (m_seeded) {
+    return true;
+  }
+
+  int ret = mbedtls_hmac_drbg_seed(m_drbg, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                                   mbedtls_entropy_func, m_entropy, nullptr, 0);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    // a failed seeding may leave the digest context set up, which a retry would set up again
+    mbedtls_hmac_drbg_free(m_drbg);
+    mbedtls_hmac_drbg_init(m_drbg);
+    return false;
+  }
+  mbedtls_hmac_drbg_set_reseed_interval(m_drbg, ReseedInterval);
+  m_seeded = true;
+  return true;
+}
+
+int
+Random::rng(void* self, unsigned char* output, size_t len) noexcept {
+  Random* random = static_cast<Random*>(self);
+  if (!random->seed()) {
+    return MBEDTLS_ERR_HMAC_DRBG_ENTROPY_SOURCE_FAILED;
+  }
+  return mbedtls_hmac_drbg_random(random->m_drbg, output, len);
+}
+
+} // namespace spake2
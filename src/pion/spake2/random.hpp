@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_RANDOM_HPP
+#define PION_SPAKE2_RANDOM_HPP
+
+#include "mbedtls-wrappers.hpp"
+
+#include <mbedtls/hmac_drbg.h>
+
+namespace spake2 {
+
+/**
+ * @brief Entropy source and HMAC_DRBG owned by one thread.
+ *
+ * mbedtls entropy and DRBG contexts must not be used concurrently. Each thread, or each worker,
+ * has its own Random seeded from the platform entropy source, so that handshakes on different
+ * threads share neither state nor locks. The DRBG is reseeded from the entropy source every
+ * ReseedInterval requests.
+ *
+ * The DRBG is seeded on first use rather than in the constructor, because a Random with static
+ * storage duration may be constructed before the entropy source is ready.
+ *
+ * A Random, and every Context, pool, or session given that Random, must only be used by the
+ * thread that owns it.
+ */
+class Random {
+public:
+  enum {
+    ReseedInterval = 1024,
+  };
+
+  /** @brief Return the instance of the current thread, created on first use. */
+  static Random& forThisThread() noexcept {
+    static thread_local Random instance;
+    return instance;
+  }
+
+  Random() = default;
+
+  Random(const Random&) = delete;
+  Random& operator=(const Random&) = delete;
+
+  /**
+   * @brief Seed the DRBG from the entropy source, unless it is already seeded.
+   * @return whether the DRBG is seeded; if false, a later call tries again.
+   */
+  bool seed() noexcept;
+
+  /** @brief Return whether the DRBG has been seeded. */
+  bool isSeeded() const noexcept {
+    return m_seeded;
+  }
+
+  /**
+   * @brief Generate random octets, with the signature of an mbedtls f_rng callback.
+   * @param self pointer to Random.
+   * @return 0, or an error code if the DRBG cannot be seeded.
+   */
+  static int rng(void* self, unsigned char* output, size_t len) noexcept;
+
+  /** @brief Generate random octets. */
+  bool generate(uint8_t* output, size_t len) noexcept {
+    return rng(this, output, len) == 0;
+  }
+
+private:
+  mbed::Entropy m_entropy;
+  mbed::Object<mbedtls_hmac_drbg_context, mbedtls_hmac_drbg_init, mbedtls_hmac_drbg_free> m_drbg;
+  bool m_seeded = false;
+};
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_RANDOM_HPP
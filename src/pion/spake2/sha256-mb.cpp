@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "sha256-mb.hpp"
+#include "cpu.hpp"
+
+#include <mbedtls/md.h>
+#include <mbedtls/platform_util.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PION_SPAKE2_SHA256_AVX2
+#include <immintrin.h>
+#define PION_SPAKE2_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+namespace spake2 {
+namespace {
+
+const mbedtls_md_info_t*
+mdInfo() {
+  return mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+}
+
+#ifdef PION_SPAKE2_SHA256_AVX2
+
+enum {
+  Lanes = Sha256Batch::Lanes,
+  BlockSize = Sha256Batch::BlockSize,
+  OutputSize = Sha256Batch::OutputSize,
+};
+
+/** @brief Chaining values of all lanes, word-major so that a word of all lanes is contiguous. */
+struct State {
+  uint32_t s[8][Lanes];
+};
+
+const uint32_t IV[8]{
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const uint32_t K[64]{
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+const uint8_t ZeroBlock[BlockSize]{};
+
+inline uint32_t
+load32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+         static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+}
+
+template<int N>
+PION_SPAKE2_AVX2_TARGET inline __m256i
+vror(__m256i x) {
+  return _mm256_or_si256(_mm256_srli_epi32(x, N), _mm256_slli_epi32(x, 32 - N));
+}
+
+PION_SPAKE2_AVX2_TARGET inline __m256i
+vadd(__m256i a, __m256i b) {
+  return _mm256_add_epi32(a, b);
+}
+
+PION_SPAKE2_AVX2_TARGET inline __m256i
+vxor3(__m256i a, __m256i b, __m256i c) {
+  return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+}
+
+/**
+ * @brief Compress one block into each lane whose bit is set in @p active .
+ * @param blocks block of each lane; inactive lanes must point to readable memory.
+ *
+ * Each 256-bit register holds one word of all eight lanes.
+ */
+PION_SPAKE2_AVX2_TARGET void
+compress(State& st, const uint8_t* const blocks[Lanes], unsigned active) {
+  // message schedule, kept as a ring of the last 16 words
+  __m256i w[16];
+  for (int t = 0; t < 16; ++t) {
+    w[t] = _mm256_setr_epi32(
+      static_cast<int>(load32(&blocks[0][4 * t])), static_cast<int>(load32(&blocks[1][4 * t])),
+      static_cast<int>(load32(&blocks[2][4 * t])), static_cast<int>(load32(&blocks[3][4 * t])),
+      static_cast<int>(load32(&blocks[4][4 * t])), static_cast<int>(load32(&blocks[5][4 * t])),
+      static_cast<int>(load32(&blocks[6][4 * t])), static_cast<int>(load32(&blocks[7][4 * t])));
+  }
+
+  __m256i v[8];
+  for (int i = 0; i < 8; ++i) {
+    v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(st.s[i]));
+  }
+  for (int t = 0; t < 64; ++t) {
+    if (t >= 16) {
+      __m256i w15 = w[(t - 15) & 15];
+      __m256i w2 = w[(t - 2) & 15];
+      __m256i s0 = vxor3(vror<7>(w15), vror<18>(w15), _mm256_srli_epi32(w15, 3));
+      __m256i s1 = vxor3(vror<17>(w2), vror<19>(w2), _mm256_srli_epi32(w2, 10));
+      w[t & 15] = vadd(vadd(w[t & 15], s0), vadd(w[(t - 7) & 15], s1));
+    }
+    __m256i e = v[4];
+    __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, v[5]), _mm256_andnot_si256(e, v[6]));
+    __m256i t1 = vadd(vadd(v[7], vxor3(vror<6>(e), vror<11>(e), vror<25>(e))),
+                      vadd(ch, vadd(_mm256_set1_epi32(static_cast<int>(K[t])), w[t & 15])));
+    __m256i a = v[0];
+    __m256i maj = _mm256_or_si256(_mm256_and_si256(a, v[1]),
+                                  _mm256_and_si256(v[2], _mm256_or_si256(a, v[1])));
+    __m256i t2 = vadd(vxor3(vror<2>(a), vror<13>(a), vror<22>(a)), maj);
+    std::copy_backward(v, v + 7, v + 8);
+    v[4] = vadd(v[4], t1);
+    v[0] = vadd(t1, t2);
+  }
+
+  __m256i mask = _mm256_setr_epi32(
+    -static_cast<int>(active & 1), -static_cast<int>((active >> 1) & 1),
+    -static_cast<int>((active >> 2) & 1), -static_cast<int>((active >> 3) & 1),
+    -static_cast<int>((active >> 4) & 1), -static_cast<int>((active >> 5) & 1),
+    -static_cast<int>((active >> 6) & 1), -static_cast<int>((active >> 7) & 1));
+  for (int i = 0; i < 8; ++i) {
+    __m256i* p = reinterpret_cast<__m256i*>(st.s[i]);
+    __m256i old = _mm256_loadu_si256(p);
+    _mm256_storeu_si256(p, _mm256_blendv_epi8(old, vadd(old, v[i]), mask));
+  }
+  mbedtls_platform_zeroize(w, sizeof(w));
+}
+
+void
+init(State& st) {
+  for (int i = 0; i < 8; ++i) {
+    std::fill_n(st.s[i], Lanes, IV[i]);
+  }
+}
+
+/**
+ * @brief Hash the remaining input of @p m lanes and apply the final padding.
+ * @param prefixLen number of octets already compressed into each lane.
+ */
+void
+finish(State& st, size_t m, const uint8_t* const* msg, const size_t* len, size_t prefixLen) {
+  uint8_t tail[Lanes][2 * BlockSize];
+  size_t nFull[Lanes]{};
+  size_t nBlocks[Lanes]{};
+  size_t maxBlocks = 0;
+  for (size_t lane = 0; lane < m; ++lane) {
+    nFull[lane] = len[lane] / BlockSize;
+    size_t rem = len[lane] % BlockSize;
+    std::memset(tail[lane], 0, sizeof(tail[lane]));
+    std::copy_n(msg[lane] + nFull[lane] * BlockSize, rem, tail[lane]);
+    tail[lane][rem] = 0x80;
+    size_t nTail = rem + 1 + 8 <= BlockSize ? 1 : 2;
+    uint64_t bits = static_cast<uint64_t>(prefixLen + len[lane]) * 8;
+    for (int i = 0; i < 8; ++i) {
+      tail[lane][nTail * BlockSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    nBlocks[lane] = nFull[lane] + nTail;
+    maxBlocks = std::max(maxBlocks, nBlocks[lane]);
+  }
+
+  const uint8_t* blocks[Lanes];
+  for (size_t b = 0; b < maxBlocks; ++b) {
+    unsigned active = 0;
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+      if (lane >= m || b >= nBlocks[lane]) {
+        blocks[lane] = ZeroBlock;
+        continue;
+      }
+      blocks[lane] = b < nFull[lane] ? msg[lane] + b * BlockSize
+                                     : tail[lane] + (b - nFull[lane]) * BlockSize;
+      active |= 1U << lane;
+    }
+    compress(st, blocks, active);
+  }
+  mbedtls_platform_zeroize(tail, sizeof(tail));
+}
+
+void
+output(const State& st, size_t lane, uint8_t out[OutputSize]) {
+  for (int i = 0; i < 8; ++i) {
+    uint32_t x = st.s[i][lane];
+    out[4 * i] = static_cast<uint8_t>(x >> 24);
+    out[4 * i + 1] = static_cast<uint8_t>(x >> 16);
+    out[4 * i + 2] = static_cast<uint8_t>(x >> 8);
+    out[4 * i + 3] = static_cast<uint8_t>(x);
+  }
+}
+
+/** @brief Start each lane with the key block K0 XOR @p pad . */
+void
+startKeyed(State& st, size_t m, const uint8_t (*k0)[BlockSize], uint8_t pad) {
+  uint8_t padded[Lanes][BlockSize];
+  const uint8_t* blocks[Lanes];
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    if (lane < m) {
+      for (int i = 0; i < BlockSize; ++i) {
+        padded[lane][i] = k0[lane][i] ^ pad;
+      }
+      blocks[lane] = padded[lane];
+    } else {
+      blocks[lane] = ZeroBlock;
+    }
+  }
+  init(st);
+  compress(st, blocks, (1U << m) - 1);
+  mbedtls_platform_zeroize(padded, sizeof(padded));
+}
+
+void
+digestLanes(size_t n, const uint8_t* const* msg, const size_t* len, uint8_t (*out)[OutputSize]) {
+  State st;
+  for (size_t i = 0; i < n; i += Lanes) {
+    size_t m = std::min<size_t>(n - i, Lanes);
+    init(st);
+    finish(st, m, msg + i, len + i, 0);
+    for (size_t lane = 0; lane < m; ++lane) {
+      output(st, lane, out[i + lane]);
+    }
+  }
+}
+
+void
+hmacLanes(size_t n, const uint8_t* const* key, const size_t* keyLen, const uint8_t* const* msg,
+          const size_t* len, uint8_t (*out)[OutputSize]) {
+  State st;
+  uint8_t k0[Lanes][BlockSize];
+  uint8_t inner[Lanes][OutputSize];
+  const uint8_t* innerPtr[Lanes];
+  size_t innerLen[Lanes];
+  for (size_t i = 0; i < n; i += Lanes) {
+    size_t m = std::min<size_t>(n - i, Lanes);
+    for (size_t lane = 0; lane < m; ++lane) {
+      // K0 is the key padded with zeros, or the digest of a key longer than a block
+      std::memset(k0[lane], 0, BlockSize);
+      if (keyLen[i + lane] > BlockSize) {
+        auto hashed = reinterpret_cast<uint8_t(*)[OutputSize]>(k0[lane]);
+        digestLanes(1, &key[i + lane], &keyLen[i + lane], hashed);
+      } else {
+        std::copy_n(key[i + lane], keyLen[i + lane], k0[lane]);
+      }
+      innerPtr[lane] = inner[lane];
+      innerLen[lane] = OutputSize;
+    }
+
+    // inner = H((K0 ^ ipad) || msg)
+    startKeyed(st, m, k0, 0x36);
+    finish(st, m, msg + i, len + i, BlockSize);
+    for (size_t lane = 0; lane < m; ++lane) {
+      output(st, lane, inner[lane]);
+    }
+
+    // out = H((K0 ^ opad) || inner)
+    startKeyed(st, m, k0, 0x5c);
+    finish(st, m, innerPtr, innerLen, BlockSize);
+    for (size_t lane = 0; lane < m; ++lane) {
+      output(st, lane, out[i + lane]);
+    }
+  }
+  mbedtls_platform_zeroize(&st, sizeof(st));
+  mbedtls_platform_zeroize(k0, sizeof(k0));
+  mbedtls_platform_zeroize(inner, sizeof(inner));
+}
+
+/** @brief Compare the AVX2 kernel with mbedtls, on lengths that cover every padding case. */
+bool
+selfTestAvx2() {
+  static const size_t lengths[Lanes]{0, 3, 55, 56, 63, 64, 119, 200};
+  static const size_t keyLengths[Lanes]{200, 119, 64, 63, 56, 55, 3, 0};
+  uint8_t buf[200];
+  for (size_t i = 0; i < sizeof(buf); ++i) {
+    buf[i] = static_cast<uint8_t>(7 * i + 1);
+  }
+  const uint8_t* msg[Lanes];
+  std::fill_n(msg, Lanes, buf);
+
+  uint8_t digests[Lanes][OutputSize];
+  uint8_t macs[Lanes][OutputSize];
+  digestLanes(Lanes, msg, lengths, digests);
+  hmacLanes(Lanes, msg, keyLengths, msg, lengths, macs);
+
+  uint8_t expected[OutputSize];
+  for (size_t lane = 0; lane < Lanes; ++lane) {
+    if (mbedtls_md(mdInfo(), buf, lengths[lane], expected) != 0 ||
+        std::memcmp(digests[lane], expected, OutputSize) != 0 ||
+        mbedtls_md_hmac(mdInfo(), buf, keyLengths[lane], buf, lengths[lane], expected) != 0 ||
+        std::memcmp(macs[lane], expected, OutputSize) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif // PION_SPAKE2_SHA256_AVX2
+
+} // namespace
+
+Sha256Batch::Kernel
+Sha256Batch::getKernel() noexcept {
+#ifdef PION_SPAKE2_SHA256_AVX2
+  static const Kernel kernel =
+    CpuFeatures::get().avx2 && selfTestAvx2() ? Kernel::Avx2 : Kernel::Mbedtls;
+  return kernel;
+#else
+  return Kernel::Mbedtls;
+#endif
+}
+
+bool
+Sha256Batch::digest(size_t n, const uint8_t* const* msg, const size_t* len,
+                    uint8_t (*out)[OutputSize]) noexcept {
+#ifdef PION_SPAKE2_SHA256_AVX2
+  if (getKernel() == Kernel::Avx2) {
+    digestLanes(n, msg, len, out);
+    return true;
+  }
+#endif
+  for (size_t i = 0; i < n; ++i) {
+    int ret = mbedtls_md(mdInfo(), msg[i], len[i], out[i]);
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+Sha256Batch::hmac(size_t n, const uint8_t* const* key, const size_t* keyLen,
+                  const uint8_t* const* msg, const size_t* len,
+                  uint8_t (*out)[OutputSize]) noexcept {
+#ifdef PION_SPAKE2_SHA256_AVX2
+  if (getKernel() == Kernel::Avx2) {
+    hmacLanes(n, key, keyLen, msg, len, out);
+    return true;
+  }
+#endif
+  for (size_t i = 0; i < n; ++i) {
+    int ret = mbedtls_md_hmac(mdInfo(), key[i], keyLen[i], msg[i], len[i], out[i]);
+    if (ret != 0) {
+      SPAKE2_MBED_ERR(ret);
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace spake2
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_SHA256_MB_HPP
+#define PION_SPAKE2_SHA256_MB_HPP
+
+#include "mbedtls-wrappers.hpp"
+
+namespace spake2 {
+
+/**
+ * @brief Multi-buffer SHA-256 and HMAC-SHA256.
+ *
+ * Independent messages are hashed together, one message per lane. On x86-64 processors with AVX2,
+ * eight lanes are compressed at once in 256-bit registers. Messages may have different lengths: a
+ * lane that has run out of blocks is masked while the others continue. Elsewhere, the messages are
+ * hashed one after another by mbedtls.
+ *
+ * This is meant for callers that have several messages at hand, such as Batch. A single message
+ * is better served by mbedtls directly.
+ */
+class Sha256Batch {
+public:
+  enum {
+    Lanes = 8,
+    BlockSize = 64,
+    OutputSize = 32,
+  };
+
+  /** @brief Implementation of the lanes. */
+  enum class Kernel {
+    Mbedtls, ///< one message after another in mbedtls
+    Avx2,    ///< eight lanes in 256-bit registers
+  };
+
+  /**
+   * @brief Return the implementation used on this processor.
+   *
+   * It is selected on first use: the AVX2 kernel is used if CpuFeatures reports AVX2 and the kernel
+   * reproduces the digests and MACs computed by mbedtls on test messages.
+   */
+  static Kernel getKernel() noexcept;
+
+  /**
+   * @brief Compute SHA-256 of @p n messages.
+   * @param msg message of each lane.
+   * @param len length of each message.
+   * @param[out] out digest of each message.
+   * @return whether success.
+   */
+  static bool digest(size_t n, const uint8_t* const* msg, const size_t* len,
+                     uint8_t (*out)[OutputSize]) noexcept;
+
+  /**
+   * @brief Compute HMAC-SHA256 of @p n messages, each with its own key.
+   * @param key key of each lane.
+   * @param keyLen length of each key.
+   * @param msg message of each lane.
+   * @param len length of each message.
+   * @param[out] out MAC of each message.
+   * @return whether success.
+   */
+  static bool hmac(size_t n, const uint8_t* const* key, const size_t* keyLen,
+                   const uint8_t* const* msg, const size_t* len,
+                   uint8_t (*out)[OutputSize]) noexcept;
+};
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_SHA256_MB_HPP
@@ -1,22 +1,55 @@
 // SPDX-License-Identifier: NIST-PD
 
-#include "spake2.hpp"
-
-#include <endian.h>
+#include "context-impl.hpp"
 
 namespace spake2 {
 namespace detail {
 
-void
-appendToTranscript(std::vector<uint8_t>& transcript, const uint8_t* buf, size_t buflen) {
-  uint64_t len = htole64(buflen);
-  auto lenptr = reinterpret_cast<const uint8_t*>(&len);
-  transcript.insert(transcript.end(), lenptr, lenptr + sizeof(len));
-  transcript.insert(transcript.end(), buf, buf + buflen);
-}
+const ndnph::mbedtls::Mpi WeierstrassOpsBase::s_one{1};
+
+int
+WeierstrassOpsBase::readPoint(const mbedtls_ecp_group* grp, mbedtls_ecp_point* P,
+                              const uint8_t* buf, size_t len) noexcept {
+  size_t pLen = mbedtls_mpi_size(&grp->P);
+  if (len != pLen + 1 || (buf[0] != 0x02 && buf[0] != 0x03)) {
+    return mbedtls_ecp_point_read_binary(grp, P, buf, len);
+  }
+
+  ndnph::mbedtls::Mpi rhs;
+  ndnph::mbedtls::Mpi e;
+  int ret = 0;
+  MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&P->X, buf + 1, pLen));
+  if (mbedtls_mpi_cmp_mpi(&P->X, &grp->P) >= 0) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+
+  // rhs = x^3 - 3x + b
+  MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(rhs, &P->X, &P->X));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_sub_int(rhs, rhs, 3));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(rhs, rhs, &P->X));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_add_mpi(rhs, rhs, &grp->B));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(rhs, rhs, &grp->P));
 
-const ndnph::mbedtls::Mpi ContextBase::s_one{1};
-const ndnph::mbedtls::Mpi ContextBase::s_minusOne{-1};
+  // y = rhs^((p + 1) / 4), which is a square root of rhs if there is one
+  MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(e, &grp->P, 1));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_shift_r(e, 2));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_exp_mod(&P->Y, rhs, e, &grp->P, nullptr));
+
+  MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(e, &P->Y, &P->Y));
+  MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(e, e, &grp->P));
+  if (mbedtls_mpi_cmp_mpi(e, rhs) != 0) {
+    return MBEDTLS_ERR_ECP_INVALID_KEY;
+  }
+
+  // choose the root whose parity matches the prefix
+  if (mbedtls_mpi_get_bit(&P->Y, 0) != (buf[0] & 0x01)) {
+    MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&P->Y, &grp->P, &P->Y));
+  }
+  MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&P->Z, 1));
+
+cleanup:
+  return ret;
+}
 
 } // namespace detail
 
@@ -77,4 +110,21 @@ const uint8_t P521::N[] = {
   0x02, 0x06, 0x42, 0x4b, 0x3f, 0xe7, 0x96, 0x8a, 0xa8, 0xe0, 0xb1, 0xf3, 0x34,
 };
 
+template class Context<Role::Alice, P256, SHA256>;
+template class Context<Role::Bob, P256, SHA256>;
+template class Context<Role::Alice, P256, SHA512>;
+template class Context<Role::Bob, P256, SHA512>;
+template class Context<Role::Alice, P384, SHA256>;
+template class Context<Role::Bob, P384, SHA256>;
+template class Context<Role::Alice, P384, SHA512>;
+template class Context<Role::Bob, P384, SHA512>;
+template class Context<Role::Alice, P521, SHA256>;
+template class Context<Role::Bob, P521, SHA256>;
+template class Context<Role::Alice, P521, SHA512>;
+template class Context<Role::Bob, P521, SHA512>;
+template class Context<Role::Alice, Edwards25519, SHA256>;
+template class Context<Role::Bob, Edwards25519, SHA256>;
+template class Context<Role::Alice, Edwards25519, SHA512>;
+template class Context<Role::Bob, Edwards25519, SHA512>;
+
 } // namespace spake2
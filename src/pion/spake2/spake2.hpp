@@ -3,25 +3,19 @@
 #ifndef PION_SPAKE2_SPAKE2_HPP
 #define PION_SPAKE2_SPAKE2_HPP
 
-#include "mbedtls-wrappers.hpp"
+#include "arena.hpp"
+#include "edwards25519.hpp"
+#include "ephemeral.hpp"
+#include "p256-native.hpp"
+#include "random.hpp"
+#include "stats.hpp"
+#include "verifier.hpp"
+#include "weierstrass.hpp"
 
-#include <vector>
-
-#include <mbedtls/hkdf.h>
-#include <mbedtls/hmac_drbg.h>
 #include <mbedtls/md.h>
-
-#ifdef SPAKE2_DEBUG
-#include <iostream>
-#define SPAKE2_MBED_ERR(x)                                                                         \
-  do {                                                                                             \
-    std::cerr << __FILE__ << ':' << __LINE__ << ": mbedtls error " << (x) << '\n';                 \
-  } while (false)
-#else
-#define SPAKE2_MBED_ERR(x)                                                                         \
-  do {                                                                                             \
-  } while (false)
-#endif
+#include <mbedtls/platform_util.h>
+#include <mbedtls/sha256.h>
+#include <mbedtls/sha512.h>
 
 namespace spake2 {
 
@@ -30,6 +24,16 @@ enum class Role {
   Bob,
 };
 
+template<typename Ctx, size_t Capacity>
+class Batch;
+
+/** @brief Result of an incremental operation. */
+enum class Progress {
+  Failure,
+  InProgress,
+  Complete,
+};
+
 namespace detail {
 
 // std::max is not constexpr in C++11
@@ -39,8 +43,60 @@ max(const T& a, const T& b) {
   return a < b ? b : a;
 }
 
-void
-appendToTranscript(std::vector<uint8_t>& transcript, const uint8_t* buf, size_t buflen);
+/** @brief Byte buffer with inline storage of fixed capacity. */
+template<size_t Capacity>
+class FixedBuffer {
+public:
+  const uint8_t* data() const noexcept {
+    return m_buf.data();
+  }
+
+  size_t size() const noexcept {
+    return m_size;
+  }
+
+  /**
+   * @brief Append bytes.
+   * @return whether success; false if capacity would be exceeded.
+   */
+  bool append(const uint8_t* buf, size_t len) noexcept {
+    if (len > Capacity - m_size) {
+      return false;
+    }
+    std::copy_n(buf, len, &m_buf[m_size]);
+    m_size += len;
+    return true;
+  }
+
+  /** @brief Wipe and discard bytes after the first @p size bytes. */
+  void truncate(size_t size) noexcept {
+    if (size < m_size) {
+      mbedtls_platform_zeroize(&m_buf[size], m_size - size);
+      m_size = size;
+    }
+  }
+
+private:
+  std::array<uint8_t, Capacity> m_buf{};
+  size_t m_size = 0;
+};
+
+/**
+ * @brief Append a transcript element: 8-octet little-endian length followed by the value.
+ * @return whether success; false if capacity would be exceeded.
+ */
+template<size_t Capacity>
+bool
+appendToTranscript(FixedBuffer<Capacity>& transcript, const uint8_t* buf, size_t buflen) {
+  uint8_t len[sizeof(uint64_t)];
+  uint64_t n = buflen;
+  for (auto& b : len) {
+    b = static_cast<uint8_t>(n);
+    n >>= 8;
+  }
+  return buflen <= Capacity - sizeof(len) && transcript.append(len, sizeof(len)) &&
+         transcript.append(buf, buflen);
+}
 
 class ContextBase {
 protected:
@@ -54,18 +110,21 @@ protected:
   };
 
   State m_state = State::Initial;
-
-  static const ndnph::mbedtls::Mpi s_one;
-  static const ndnph::mbedtls::Mpi s_minusOne;
 };
 
 } // namespace detail
 
 struct P256 {
+#ifdef PION_SPAKE2_P256_NATIVE
+  using Ops = detail::P256NativeOps;
+#else
+  using Ops = detail::WeierstrassOps<P256>;
+#endif
   static constexpr mbedtls_ecp_group_id Id = MBEDTLS_ECP_DP_SECP256R1;
   enum {
     ScalarSize = 32,
     UncompressedPointSize = 65,
+    CompressedPointSize = 33,
   };
 
   static const uint8_t M[UncompressedPointSize];
@@ -73,10 +132,12 @@ struct P256 {
 };
 
 struct P384 {
+  using Ops = detail::WeierstrassOps<P384>;
   static constexpr mbedtls_ecp_group_id Id = MBEDTLS_ECP_DP_SECP384R1;
   enum {
     ScalarSize = 48,
     UncompressedPointSize = 97,
+    CompressedPointSize = 49,
   };
 
   static const uint8_t M[UncompressedPointSize];
@@ -84,27 +145,66 @@ struct P384 {
 };
 
 struct P521 {
+  using Ops = detail::WeierstrassOps<P521>;
   static constexpr mbedtls_ecp_group_id Id = MBEDTLS_ECP_DP_SECP521R1;
   enum {
     ScalarSize = 66,
     UncompressedPointSize = 133,
+    CompressedPointSize = 67,
+  };
+
+  static const uint8_t M[UncompressedPointSize];
+  static const uint8_t N[UncompressedPointSize];
+};
+
+/**
+ * @brief edwards25519, as in the SPAKE2-edwards25519-SHA256-HKDF-HMAC ciphersuite.
+ *
+ * Points are encoded in 32 octets as in RFC 8032, so that CompressedPointSize equals
+ * UncompressedPointSize.
+ */
+struct Edwards25519 {
+  using Ops = detail::Edwards25519Ops;
+  enum {
+    ScalarSize = 32,
+    UncompressedPointSize = 32,
+    CompressedPointSize = 32,
   };
 
   static const uint8_t M[UncompressedPointSize];
   static const uint8_t N[UncompressedPointSize];
 };
 
+/**
+ * @brief Upper bounds of variable-length inputs to Context::start().
+ * @tparam maxIdLen maximum length of each identity.
+ * @tparam maxAadLen maximum length of the Additional Authenticated Data (AAD).
+ *
+ * These bounds determine the capacity of the inline transcript and KDF info buffers.
+ */
+template<size_t maxIdLen = 64, size_t maxAadLen = 32>
+struct Limits {
+  enum {
+    MaxIdLen = maxIdLen,
+    MaxAadLen = maxAadLen,
+  };
+};
+
 struct SHA256 {
   static constexpr mbedtls_md_type_t Type = MBEDTLS_MD_SHA256;
+  using State = mbedtls_sha256_context;
   enum {
     OutputSize = 32,
+    BlockSize = 64,
   };
 };
 
 struct SHA512 {
   static constexpr mbedtls_md_type_t Type = MBEDTLS_MD_SHA512;
+  using State = mbedtls_sha512_context;
   enum {
     OutputSize = 64,
+    BlockSize = 128,
   };
 };
 
@@ -116,393 +216,325 @@ struct SHA512 {
  *
  * @sa https://www.ietf.org/archive/id/draft-irtf-cfrg-spake2-26.html
  */
-template<Role role, typename Group = P256, typename Hash = SHA256>
+template<Role role, typename Group = P256, typename Hash = SHA256, typename Bounds = Limits<>>
 class Context final : detail::ContextBase {
 public:
   static_assert(role == Role::Alice || role == Role::Bob, "");
 
   enum {
     FirstMessageSize = Group::UncompressedPointSize,
+    CompressedFirstMessageSize = Group::CompressedPointSize,
     SecondMessageSize = Hash::OutputSize,
     SharedKeySize = Hash::OutputSize / 2,
   };
 
-  explicit Context(mbedtls_entropy_context* entropyCtx) noexcept;
+  /**
+   * @brief Constructor.
+   * @param random random number generator, which must outlive the context; the context must
+   *               only be used by the thread that owns it.
+   */
+  explicit Context(Random& random) noexcept;
 
+  /**
+   * @brief Wipe all secrets and return to the initial state.
+   *
+   * The digest contexts are kept, so that the context can be reused for another
+   * exchange without setting them up again.
+   */
+  void reset() noexcept;
+
+  /**
+   * @brief Start an exchange.
+   * @return whether success; false if an identity or the AAD exceeds @c Bounds .
+   */
   bool start(const uint8_t* pw, size_t pwLen, const uint8_t* myId = nullptr, size_t myIdLen = 0,
              const uint8_t* peerId = nullptr, size_t peerIdLen = 0, const uint8_t* aad = nullptr,
              size_t aadLen = 0) noexcept;
 
-  bool generateFirstMessage(uint8_t* outMsg, size_t outMsgLen) noexcept;
-
-  bool processFirstMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept;
-
-  bool generateSecondMessage(uint8_t* outMsg, size_t outMsgLen) noexcept;
-
-  bool processSecondMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept;
+  /**
+   * @brief Start an exchange with a precomputed password verifier.
+   * @return whether success; false if an identity or the AAD exceeds @c Bounds , or if the
+   *         verifier is invalid.
+   *
+   * This is equivalent to start() with the password from which the verifier was computed. If the
+   * verifier includes w*M (Alice) or w*N (Bob), generateFirstMessage() adds it instead of
+   * computing it.
+   */
+  bool start(const Verifier<Group, Hash>& verifier, const uint8_t* myId = nullptr,
+             size_t myIdLen = 0, const uint8_t* peerId = nullptr, size_t peerIdLen = 0,
+             const uint8_t* aad = nullptr, size_t aadLen = 0) noexcept;
 
   /**
-   * @brief Returns the shared key established by the SPAKE2 exchange.
-   * @pre Can only be called after processSecondMessage() returns true.
+   * @brief Replace the random scalar chosen by start() with a precomputed ephemeral share.
+   * @pre start() has returned true, and generateFirstMessage() has not been called.
+   * @return whether success; false if the pool is empty, in which case x from start() is kept.
    */
-  const std::array<uint8_t, SharedKeySize>& getSharedKey() const noexcept {
-    assert(m_state == State::Done);
-    return m_key;
+  template<size_t Capacity>
+  bool takeEphemeral(EphemeralPool<Group, Capacity>& pool) noexcept {
+    if (m_state != State::Initial || !pool.take(m_x, m_X)) {
+      return false;
+    }
+    m_hasX = true;
+    return true;
   }
 
-private:
-  std::array<uint8_t, detail::max(FirstMessageSize, SecondMessageSize)> m_myMsg{};
-  std::array<uint8_t, Hash::OutputSize> m_expectedMac{};
-  std::array<uint8_t, SharedKeySize> m_key{};
-
-  mbed::Object<mbedtls_hmac_drbg_context, mbedtls_hmac_drbg_init, mbedtls_hmac_drbg_free> m_drbg;
-  mbed::Object<mbedtls_md_context_t, mbedtls_md_init, mbedtls_md_free> m_md;
-  mbed::Object<mbedtls_ecp_group, mbedtls_ecp_group_init, mbedtls_ecp_group_free> m_group;
-
-  ndnph::mbedtls::Mpi m_w;
-  ndnph::mbedtls::Mpi m_x;
-  ndnph::mbedtls::EcPoint m_pA;
-  ndnph::mbedtls::EcPoint m_M;
-  ndnph::mbedtls::EcPoint m_N;
-
-  std::vector<uint8_t> m_transcript;
-  std::vector<uint8_t> m_info{
-    'C', 'o', 'n', 'f', 'i', 'r', 'm', 'a', 't', 'i', 'o', 'n', 'K', 'e', 'y', 's',
-  };
-};
-
-template<Role role, typename Group, typename Hash>
-Context<role, Group, Hash>::Context(mbedtls_entropy_context* entropyCtx) noexcept {
-  assert(entropyCtx != nullptr);
-
-  auto mdInfo = mbedtls_md_info_from_type(Hash::Type);
-  assert(mdInfo != nullptr);
-
-  // Initialize HMAC_DRBG context
-  int ret = mbedtls_hmac_drbg_seed(m_drbg, mdInfo, mbedtls_entropy_func, entropyCtx, nullptr, 0);
-  assert(ret == 0);
+  /**
+   * @brief Set the computation budget of each call to an incremental function.
+   * @param maxOps maximum number of basic EC operations, see mbedtls_ecp_set_max_ops().
+   *
+   * With the default 0, each call performs at most one scalar multiplication. A nonzero budget
+   * splits scalar multiplications further; with a NIST curve, the multiplication of a share taken
+   * from an EphemeralPool is only split if mbedtls is built with MBEDTLS_ECP_RESTARTABLE.
+   * Building the table of the peer's share in processFirstMessageStep() counts against the same
+   * budget. A call may exceed the budget by one step: a column of the comb on NIST curves, or the
+   * whole table on edwards25519.
+   * The budget is cleared by reset().
+   */
+  void setMaxOps(unsigned maxOps) noexcept {
+    m_maxOps = maxOps;
+  }
 
-  // Initialize digest context
-  ret = mbedtls_md_setup(m_md, mdInfo, 1);
-  assert(ret == 0);
+  /**
+   * @brief Serve the bignum allocations of start() and the incremental functions from an arena.
+   * @param arena the arena, or nullptr to use the heap; it must outlive its use by this context.
+   * @pre Arena::install() has been called.
+   *
+   * The setting is cleared by reset(), like the budget.
+   */
+  void setArena(Arena* arena) noexcept {
+    m_arena = arena;
+  }
 
-  // Initialize EC group
-  ret = mbedtls_ecp_group_load(m_group, Group::Id);
-  assert(ret == 0);
+  /**
+   * @brief Generate the public share.
+   * @param outMsgLen either FirstMessageSize for an uncompressed point, or
+   *                  CompressedFirstMessageSize for a compressed point.
+   *
+   * The transcript always contains the uncompressed point, so that the wire format does not
+   * affect the derived keys.
+   */
+  bool generateFirstMessage(uint8_t* outMsg, size_t outMsgLen) noexcept {
+    Progress progress;
+    do {
+      progress = generateFirstMessageStep(outMsg, outMsgLen);
+    } while (progress == Progress::InProgress);
+    return progress == Progress::Complete;
+  }
 
-  // Load protocol constants M and N
-  ret = mbedtls_ecp_point_read_binary(m_group, m_M, Group::M, sizeof(Group::M));
-  assert(ret == 0);
-  ret = mbedtls_ecp_point_read_binary(m_group, m_N, Group::N, sizeof(Group::N));
-  assert(ret == 0);
-}
+  /**
+   * @brief Incremental version of generateFirstMessage().
+   * @return Progress::InProgress if the function should be called again with the same arguments.
+   * @sa setMaxOps()
+   */
+  Progress generateFirstMessageStep(uint8_t* outMsg, size_t outMsgLen) noexcept;
 
-template<Role role, typename Group, typename Hash>
-bool
-Context<role, Group, Hash>::start(const uint8_t* pw, size_t pwLen, const uint8_t* myId,
-                                  size_t myIdLen, const uint8_t* peerId, size_t peerIdLen,
-                                  const uint8_t* aad, size_t aadLen) noexcept {
-  // TODO: sanity-check state machine?
-
-  // Allocate memory for the transcript and copy the identities
-  m_transcript.reserve(sizeof(uint64_t) * 6 +             // lengths
-                       myIdLen + peerIdLen +              // identities
-                       Group::UncompressedPointSize * 3 + // pA, pB, K (points)
-                       Group::ScalarSize);                // w (scalar)
-  if (role == Role::Alice) {
-    detail::appendToTranscript(m_transcript, myId, myIdLen);
-    detail::appendToTranscript(m_transcript, peerId, peerIdLen);
-  } else {
-    detail::appendToTranscript(m_transcript, peerId, peerIdLen);
-    detail::appendToTranscript(m_transcript, myId, myIdLen);
+  /**
+   * @brief Process the peer's public share.
+   * @param inMsgLen either FirstMessageSize for an uncompressed point, or
+   *                 CompressedFirstMessageSize for a compressed point.
+   */
+  bool processFirstMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept {
+    Progress progress;
+    do {
+      progress = processFirstMessageStep(inMsg, inMsgLen);
+    } while (progress == Progress::InProgress);
+    return progress == Progress::Complete;
   }
 
-  // Append the Additional Authenticated Data (AAD) to the KDF info string
-  m_info.insert(m_info.end(), aad, aad + aadLen);
+  /**
+   * @brief Incremental version of processFirstMessage().
+   * @return Progress::InProgress if the function should be called again with the same arguments.
+   * @sa setMaxOps()
+   */
+  Progress processFirstMessageStep(const uint8_t* inMsg, size_t inMsgLen) noexcept;
 
-  // Calculate the hash of the user-supplied password pw
-  std::array<uint8_t, Hash::OutputSize> pwHash{};
-  int ret = mbedtls_md_starts(m_md);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_update(m_md, pw, pwLen);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_finish(m_md, pwHash.data());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /**
+   * @brief Check that a message could be accepted by processFirstMessage().
+   * @return whether @p inMsg has a valid length and encodes a point of the group.
+   *
+   * This decodes and validates the point without any scalar multiplication, so that a bogus
+   * message can be rejected before starting an expensive exchange.
+   */
+  static bool checkFirstMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept;
 
-  ndnph::mbedtls::Mpi pwHashScalar;
-  ret = mbedtls_mpi_read_binary(pwHashScalar, pwHash.data(), pwHash.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_mpi_mod_mpi(m_w, pwHashScalar, &m_group->N);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  bool generateSecondMessage(uint8_t* outMsg, size_t outMsgLen) noexcept;
 
-  // Generate random scalar x
-  ndnph::mbedtls::Mpi random;
-  // NOTE: generate 8 extra bytes to avoid bias in modulo operation
-  ret = mbedtls_mpi_fill_random(random, Group::ScalarSize + 8, mbedtls_hmac_drbg_random, m_drbg);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_mpi_mod_mpi(m_x, random, &m_group->N);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  bool processSecondMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept;
 
-  return true;
-}
+  /**
+   * @brief State of an exchange between generateFirstMessage() and processFirstMessage().
+   *
+   * A party that waits for the peer's share only needs w, x, and its own share. Keeping these in
+   * a Checkpoint, instead of keeping the context, lets many exchanges wait while few contexts are
+   * in use. The Checkpoint holds secrets and must be cleared when no longer needed.
+   */
+  struct Checkpoint {
+    uint8_t w[Group::ScalarSize];
+    uint8_t x[Group::ScalarSize];
+    uint8_t share[FirstMessageSize]; // uncompressed
+
+    /**
+     * @brief Write the share in the format of generateFirstMessage().
+     * @param len FirstMessageSize or CompressedFirstMessageSize.
+     * @return whether success.
+     */
+    bool writeShare(uint8_t* out, size_t len) const noexcept;
+
+    /** @brief Wipe the secrets. */
+    void clear() noexcept {
+      mbedtls_platform_zeroize(this, sizeof(*this));
+    }
+  };
 
-template<Role role, typename Group, typename Hash>
-bool
-Context<role, Group, Hash>::generateFirstMessage(uint8_t* outMsg, size_t outMsgLen) noexcept {
-  if (m_state != State::Initial) {
-    return false;
-  }
+  /**
+   * @brief Save the state after generateFirstMessage() into a Checkpoint, then reset().
+   * @return whether success.
+   */
+  bool suspend(Checkpoint& checkpoint) noexcept;
 
-  // NOTE: the two mbedtls_ecp_mul() calls below are not combined into the mbedtls_ecp_muladd()
-  //       that follows because the latter is _not_ constant time while the former is.
+  /**
+   * @brief Restore the state from a Checkpoint, so that processFirstMessage() can be called.
+   * @pre the context is in the initial state, as after reset().
+   * @return whether success.
+   *
+   * The identities and AAD must be the same as those given to start().
+   */
+  bool resume(const Checkpoint& checkpoint, const uint8_t* myId = nullptr, size_t myIdLen = 0,
+              const uint8_t* peerId = nullptr, size_t peerIdLen = 0,
+              const uint8_t* aad = nullptr, size_t aadLen = 0) noexcept;
 
-  int ret;
-  ndnph::mbedtls::EcPoint X;
-  // X = x * P
-  ret = mbedtls_ecp_mul(m_group, X, m_x, &m_group->G, mbedtls_hmac_drbg_random, m_drbg);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
+  /**
+   * @brief Returns the shared key established by the SPAKE2 exchange.
+   * @pre Can only be called after processSecondMessage() returns true.
+   */
+  const std::array<uint8_t, SharedKeySize>& getSharedKey() const noexcept {
+    assert(m_state == State::Done);
+    return m_key;
   }
 
-  ndnph::mbedtls::EcPoint wMN;
-  // wMN = w * (M|N)
-  ret = mbedtls_ecp_mul(m_group, wMN, m_w, role == Role::Alice ? m_M : m_N,
-                        mbedtls_hmac_drbg_random, m_drbg);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
+private:
+  /** @brief Abandon an incremental operation. */
+  Progress fail() noexcept {
+    m_step = 0;
+    m_ops.clear();
+    return Progress::Failure;
   }
 
-  // pA = wMN + X
-  ret = mbedtls_ecp_muladd(m_group, m_pA, s_one, wMN, s_one, X);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
+  bool canGenerateFirstMessage(size_t outMsgLen) const noexcept {
+    return m_state == State::Initial &&
+           (outMsgLen == FirstMessageSize || outMsgLen == CompressedFirstMessageSize);
   }
 
-  std::array<uint8_t, Group::UncompressedPointSize> pABytes{};
-  size_t pALen = 0;
-  ret = mbedtls_ecp_point_write_binary(m_group, m_pA, MBEDTLS_ECP_PF_UNCOMPRESSED, &pALen,
-                                       pABytes.data(), pABytes.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
+  bool canProcessFirstMessage() const noexcept {
+    return m_state == State::AwaitingPublicShare;
   }
 
-  std::memcpy(m_myMsg.data(), pABytes.data(), pALen);
-  // TODO: sanity checks
-  std::memcpy(outMsg, m_myMsg.data(), outMsgLen);
+  /** @brief Reset the transcript with the identities, and the KDF info with the AAD. */
+  bool startTranscript(const uint8_t* myId, size_t myIdLen, const uint8_t* peerId,
+                       size_t peerIdLen, const uint8_t* aad, size_t aadLen) noexcept;
 
-  m_state = State::AwaitingPublicShare;
-  return true;
-}
+  /** @brief Compute w from the password. */
+  bool hashPassword(const uint8_t* pw, size_t pwLen) noexcept;
 
-template<Role role, typename Group, typename Hash>
-bool
-Context<role, Group, Hash>::processFirstMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept {
-  if (m_state != State::AwaitingPublicShare) {
-    return false;
-  }
+  /** @brief Generate the random scalar x. */
+  bool generateX() noexcept;
 
-  int ret;
-  ndnph::mbedtls::EcPoint pB;
-  ret = mbedtls_ecp_point_read_binary(m_group, pB, inMsg, inMsgLen);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  // Verify that the received point is on the curve
-  ret = mbedtls_ecp_check_pubkey(m_group, pB);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Start computing the public share in m_ops. */
+  bool beginShare() noexcept;
 
-  ndnph::mbedtls::EcPoint wNM;
-  // wNM = w * (N|M)
-  ret = mbedtls_ecp_mul(m_group, wNM, m_w, role == Role::Alice ? m_N : m_M,
-                        mbedtls_hmac_drbg_random, m_drbg);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
+  /** @brief Continue the computation in m_ops. */
+  int runOps(unsigned maxOps) noexcept {
+    SPAKE2_STATS_SCOPE(ScalarMul);
+    return m_ops.run(maxOps);
   }
 
-  ndnph::mbedtls::EcPoint Y;
-  // Y = pB - wNM
-  ret = mbedtls_ecp_muladd(m_group, Y, s_one, pB, s_minusOne, wNM);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Encode the public share computed in m_ops. */
+  Progress finishShare(uint8_t* outMsg, size_t outMsgLen) noexcept;
 
-  ndnph::mbedtls::EcPoint K;
-  // K = h * x * Y
-  // NOTE: the cofactor h is 1 for NIST curves
-  ret = mbedtls_ecp_mul(m_group, K, m_x, Y, mbedtls_hmac_drbg_random, m_drbg);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Validate the peer's public share and start computing K in m_ops. */
+  bool beginKey(const uint8_t* inMsg, size_t inMsgLen) noexcept;
 
-  std::array<uint8_t, Group::UncompressedPointSize> binK{};
-  size_t lenK = 0;
-  ret = mbedtls_ecp_point_write_binary(m_group, K, MBEDTLS_ECP_PF_UNCOMPRESSED, &lenK, binK.data(),
-                                       binK.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Derive the keys and confirmation messages from K computed in m_ops. */
+  Progress finishKey() noexcept;
 
-  std::array<uint8_t, Group::ScalarSize> binW{};
-  ret = mbedtls_mpi_write_binary(m_w, binW.data(), binW.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Complete the transcript with K computed in m_ops, and hash it into Ke || Ka. */
+  bool hashTranscript(std::array<uint8_t, Hash::OutputSize>& transcriptHash) noexcept;
 
-  // Finalize protocol transcript
-  if (role == Role::Alice) {
-    detail::appendToTranscript(m_transcript, m_myMsg.data(), FirstMessageSize);
-    detail::appendToTranscript(m_transcript, inMsg, inMsgLen);
-  } else {
-    detail::appendToTranscript(m_transcript, inMsg, inMsgLen);
-    detail::appendToTranscript(m_transcript, m_myMsg.data(), FirstMessageSize);
-  }
-  detail::appendToTranscript(m_transcript, binK.data(), lenK);
-  detail::appendToTranscript(m_transcript, binW.data(), binW.size());
-
-  // Calculate the hash of the transcript
-  std::array<uint8_t, Hash::OutputSize> transcriptHash{};
-  ret = mbedtls_md_starts(m_md);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_update(m_md, m_transcript.data(), m_transcript.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_finish(m_md, transcriptHash.data());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Keep the confirmation messages, and await the peer's. */
+  void setConfirmation(const uint8_t* macA, const uint8_t* macB) noexcept;
 
-  const uint8_t* Ke = transcriptHash.data();
-  const uint8_t* Ka = transcriptHash.data() + transcriptHash.size() / 2;
-  std::memcpy(m_key.data(), Ke, m_key.size());
-
-  // Derive confirmation keys (HKDF)
-  std::array<uint8_t, Hash::OutputSize> Kc{};
-  ret = mbedtls_hkdf(mbedtls_md_info_from_type(Hash::Type), nullptr, 0, Ka,
-                     transcriptHash.size() / 2, m_info.data(), m_info.size(), Kc.data(), Kc.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Zeroize the hash state and HMAC pads of a digest context, keeping its allocations. */
+  static void wipeMd(mbedtls_md_context_t* md) noexcept;
 
-  const uint8_t* KcA = Kc.data();
-  const uint8_t* KcB = Kc.data() + Kc.size() / 2;
+  /** @brief Append an element to the transcript and feed it into the transcript hash. */
+  bool appendToTranscript(const uint8_t* buf, size_t buflen) noexcept;
 
-  // Construct confirmation messages (HMAC)
-  std::array<uint8_t, Hash::OutputSize> macA{};
-  ret = mbedtls_md_hmac_starts(m_md, KcA, Kc.size() / 2);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_hmac_update(m_md, m_transcript.data(), m_transcript.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_hmac_finish(m_md, macA.data());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  std::array<uint8_t, Hash::OutputSize> macB{};
-  ret = mbedtls_md_hmac_starts(m_md, KcB, Kc.size() / 2);
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_hmac_update(m_md, m_transcript.data(), m_transcript.size());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
-  ret = mbedtls_md_hmac_finish(m_md, macB.data());
-  if (ret != 0) {
-    SPAKE2_MBED_ERR(ret);
-    return false;
-  }
+  /** @brief Derive KcA || KcB from Ka with HKDF, without setting up another digest context. */
+  bool deriveConfirmationKeys(const uint8_t* Ka, size_t KaLen,
+                              std::array<uint8_t, Hash::OutputSize>& Kc) noexcept;
 
-  if (role == Role::Alice) {
-    std::memcpy(m_myMsg.data(), macA.data(), macA.size());
-    std::memcpy(m_expectedMac.data(), macB.data(), macB.size());
-  } else {
-    std::memcpy(m_myMsg.data(), macB.data(), macB.size());
-    std::memcpy(m_expectedMac.data(), macA.data(), macA.size());
-  }
+private:
+  std::array<uint8_t, detail::max(FirstMessageSize, SecondMessageSize)> m_myMsg{};
+  std::array<uint8_t, FirstMessageSize> m_peerShare{}; // uncompressed
+  std::array<uint8_t, Hash::OutputSize> m_expectedMac{};
+  std::array<uint8_t, SharedKeySize> m_key{};
 
-  m_state = State::SendingConfirmation;
-  return true;
-}
+  using Ops = typename Group::Ops;
+  using Base = typename Ops::Base;
+  using HashType = Hash;
 
-template<Role role, typename Group, typename Hash>
-bool
-Context<role, Group, Hash>::generateSecondMessage(uint8_t* outMsg, size_t outMsgLen) noexcept {
-  if (m_state != State::SendingConfirmation) {
-    return false;
-  }
+  enum {
+    InfoLabelSize = 16, // "ConfirmationKeys"
+    TranscriptCapacity = sizeof(uint64_t) * 6 +             // lengths
+                         Bounds::MaxIdLen * 2 +             // identities
+                         Group::UncompressedPointSize * 3 + // pA, pB, K (points)
+                         Group::ScalarSize,                 // w (scalar)
+    InfoCapacity = InfoLabelSize + Bounds::MaxAadLen,
+  };
 
-  // TODO: sanity checks
-  std::memcpy(outMsg, m_myMsg.data(), outMsgLen);
+  Random& m_random;
+  mbed::MdContext m_md;           // password hash
+  mbed::MdContext m_transcriptMd; // running hash of the transcript
+  mbed::MdContext m_macA;         // HMAC with KcA, also used for HKDF
+  mbed::MdContext m_macB;         // HMAC with KcB
+  Ops m_ops; // EC computations
 
-  m_state = State::AwaitingConfirmation;
-  return true;
-}
+  ndnph::mbedtls::Mpi m_w;
+  ndnph::mbedtls::Mpi m_x;
+  typename Ops::Point m_X;
+  bool m_hasX = false; // whether m_X = m_x * G has been precomputed
+  typename Ops::Point m_wB;
+  bool m_hasWB = false; // whether m_wB = m_w * (M|N) has been taken from a Verifier
 
-template<Role role, typename Group, typename Hash>
-bool
-Context<role, Group, Hash>::processSecondMessage(const uint8_t* inMsg, size_t inMsgLen) noexcept {
-  if (m_state != State::AwaitingConfirmation) {
-    return false;
-  }
+  unsigned m_maxOps = 0;
+  Arena* m_arena = nullptr;
+  uint8_t m_step = 0; // position within an incremental operation
 
-  // Check that the peer's MAC matches the one we expect
-  if (!ndnph::port::TimingSafeEqual()(inMsg, inMsgLen, m_expectedMac.data(),
-                                      m_expectedMac.size())) {
-    return false;
-  }
+  detail::FixedBuffer<TranscriptCapacity> m_transcript;
+  detail::FixedBuffer<InfoCapacity> m_info;
 
-  m_state = State::Done;
-  return true;
-}
+  template<typename Ctx, size_t Capacity>
+  friend class Batch;
+};
+
+// Contexts with the default Bounds are instantiated in spake2.cpp; include context-impl.hpp to
+// use other combinations.
+extern template class Context<Role::Alice, P256, SHA256>;
+extern template class Context<Role::Bob, P256, SHA256>;
+extern template class Context<Role::Alice, P256, SHA512>;
+extern template class Context<Role::Bob, P256, SHA512>;
+extern template class Context<Role::Alice, P384, SHA256>;
+extern template class Context<Role::Bob, P384, SHA256>;
+extern template class Context<Role::Alice, P384, SHA512>;
+extern template class Context<Role::Bob, P384, SHA512>;
+extern template class Context<Role::Alice, P521, SHA256>;
+extern template class Context<Role::Bob, P521, SHA256>;
+extern template class Context<Role::Alice, P521, SHA512>;
+extern template class Context<Role::Bob, P521, SHA512>;
+extern template class Context<Role::Alice, Edwards25519, SHA256>;
+extern template class Context<Role::Bob, Edwards25519, SHA256>;
+extern template class Context<Role::Alice, Edwards25519, SHA512>;
+extern template class Context<Role::Bob, Edwards25519, SHA512>;
 
 } // namespace spake2
 
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: NIST-PD
+
+#include "stats.hpp"
+
+namespace spake2 {
+
+namespace {
+
+thread_local Stats* t_current = nullptr;
+
+} // namespace
+
+Stats*
+Stats::current() noexcept {
+  return t_current;
+}
+
+Stats::Scope::Scope(Stats* stats) noexcept
+  : m_prev(t_current) {
+  if (stats != nullptr) {
+    t_current = stats;
+  }
+}
+
+Stats::Scope::~Scope() noexcept {
+  t_current = m_prev;
+}
+
+} // namespace spake2
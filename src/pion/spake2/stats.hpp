@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_STATS_HPP
+#define PION_SPAKE2_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef PION_SPAKE2_STATS
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace spake2 {
+
+/**
+ * @brief Time spent in each primitive operation of SPAKE2.
+ *
+ * Instrumentation is compiled in only if PION_SPAKE2_STATS is defined; otherwise the timing points
+ * are empty and Context has the same code as without this feature. In either case, the layout of
+ * Context is unchanged, because the statistics are collected into the Stats activated on the
+ * current thread by a Scope, similar to Arena.
+ *
+ * Time is counted in TSC ticks on x86, and in nanoseconds of a steady clock elsewhere.
+ */
+struct Stats {
+  enum class Op {
+    Random,        ///< generating the random scalar
+    Hash,          ///< hashing the password and the transcript
+    ScalarMul,     ///< scalar multiplications, including result normalization and encoding
+    PointValidate, ///< decoding and validating the peer's share
+    Kdf,           ///< HKDF and HMAC
+  };
+
+  enum {
+    NOps = 5,
+  };
+
+  struct Counter {
+    uint64_t ticks = 0; ///< accumulated time
+    uint32_t calls = 0; ///< number of timed sections; an incremental step counts as one
+  };
+
+  /** @brief Determine whether instrumentation is compiled in. */
+  static constexpr bool isEnabled() noexcept {
+#ifdef PION_SPAKE2_STATS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /** @brief Determine whether ticks are TSC ticks, as opposed to nanoseconds. */
+  static constexpr bool isTsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /** @brief Return the Stats active on the current thread, or nullptr. */
+  static Stats* current() noexcept;
+
+  /**
+   * @brief Collect statistics into a Stats on the current thread until the end of the scope.
+   * @param stats the Stats, or nullptr to have no effect.
+   */
+  class Scope {
+  public:
+    explicit Scope(Stats* stats) noexcept;
+
+    ~Scope() noexcept;
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    Stats* m_prev;
+  };
+
+  const Counter& operator[](Op op) const noexcept {
+    return counters[static_cast<int>(op)];
+  }
+
+  void add(Op op, uint64_t ticks) noexcept {
+    Counter& c = counters[static_cast<int>(op)];
+    c.ticks += ticks;
+    ++c.calls;
+  }
+
+  void clear() noexcept {
+    *this = Stats();
+  }
+
+  Counter counters[NOps];
+};
+
+#ifdef PION_SPAKE2_STATS
+namespace detail {
+
+inline uint64_t
+readTicks() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch())
+                                 .count());
+#endif
+}
+
+/** @brief Add the time until the end of the scope to the active Stats. */
+class StatsTimer {
+public:
+  explicit StatsTimer(Stats::Op op) noexcept
+    : m_stats(Stats::current())
+    , m_op(op) {
+    if (m_stats != nullptr) {
+      m_start = readTicks();
+    }
+  }
+
+  ~StatsTimer() noexcept {
+    if (m_stats != nullptr) {
+      m_stats->add(m_op, readTicks() - m_start);
+    }
+  }
+
+  StatsTimer(const StatsTimer&) = delete;
+  StatsTimer& operator=(const StatsTimer&) = delete;
+
+private:
+  Stats* m_stats;
+  Stats::Op m_op;
+  uint64_t m_start = 0;
+};
+
+} // namespace detail
+#endif // PION_SPAKE2_STATS
+} // namespace spake2
+
+/** @brief Add the time until the end of the enclosing block to the Stats::Op @p op . */
+#ifdef PION_SPAKE2_STATS
+#define SPAKE2_STATS_SCOPE(op)                                                                     \
+  ::spake2::detail::StatsTimer spake2StatsTimer(::spake2::Stats::Op::op)
+#else
+#define SPAKE2_STATS_SCOPE(op)                                                                     \
+  do {                                                                                             \
+  } while (false)
+#endif
+
+#endif // PION_SPAKE2_STATS_HPP
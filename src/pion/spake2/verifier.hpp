@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_VERIFIER_HPP
+#define PION_SPAKE2_VERIFIER_HPP
+
+#include "random.hpp"
+
+#include <mbedtls/md.h>
+#include <mbedtls/platform_util.h>
+
+namespace spake2 {
+
+struct SHA256;
+
+/**
+ * @brief Precomputed password verifier for Context::start().
+ * @tparam Group SPAKE2 group.
+ * @tparam Hash hash function that maps the password to the scalar w.
+ *
+ * The verifier holds w = H(pw) mod p, and optionally w*M and/or w*N. A device with a password
+ * assigned in the factory can store the verifier instead of the password: it skips hashing the
+ * password, and with w*N it also skips one scalar multiplication when it computes pB.
+ *
+ * The verifier is equivalent to the password: whoever knows it can impersonate either party.
+ * It must be stored with the same protection as the password.
+ *
+ * The encoding is: flags (1 octet, WithM | WithN), w (ScalarSize octets, big endian), then the
+ * uncompressed w*M and w*N (PointSize octets each) if indicated by the flags.
+ */
+template<typename Group, typename Hash = SHA256>
+class Verifier {
+public:
+  using Ops = typename Group::Ops;
+
+  enum : uint8_t {
+    WithM = 0x01,
+    WithN = 0x02,
+  };
+
+  enum {
+    ScalarSize = Group::ScalarSize,
+    PointSize = Group::UncompressedPointSize,
+    MaxEncodedSize = 1 + ScalarSize + 2 * PointSize,
+  };
+
+  Verifier() = default;
+
+  Verifier(const Verifier&) = delete;
+  Verifier& operator=(const Verifier&) = delete;
+
+  ~Verifier() noexcept {
+    clear();
+  }
+
+  /**
+   * @brief Compute the verifier from a password.
+   * @param points WithM, WithN, or both, to include precomputed points; 0 for w only.
+   * @param random random number generator, used for blinding the multiplications.
+   * @return whether success.
+   */
+  bool compute(const uint8_t* pw, size_t pwLen, uint8_t points, Random& random) noexcept;
+
+  /** @brief Return the size of the encoding. */
+  size_t getEncodedSize() const noexcept {
+    return 1 + ScalarSize + PointSize * (static_cast<size_t>(has(WithM)) + has(WithN));
+  }
+
+  /**
+   * @brief Encode the verifier.
+   * @return encoded size, or 0 if @p outLen is too small.
+   */
+  size_t encode(uint8_t* out, size_t outLen) const noexcept;
+
+  /**
+   * @brief Decode a verifier.
+   * @return whether success; false if the encoding is malformed or w is out of range.
+   *
+   * Precomputed points are validated when they are used by Context::start().
+   */
+  bool decode(const uint8_t* in, size_t inLen) noexcept;
+
+  /**
+   * @brief Copy another verifier.
+   * @return whether success; false if @p other is invalid, in which case this verifier is wiped.
+   *
+   * Verifiers are not copyable, so that every copy of the secret is explicit. Unlike encode() and
+   * decode(), this copies without an intermediate buffer and without validating w again.
+   */
+  bool assign(const Verifier& other) noexcept {
+    if (&other == this) {
+      return isValid();
+    }
+    clear();
+    if (!other.isValid()) {
+      return false;
+    }
+    m_flags = other.m_flags;
+    std::copy_n(other.m_w, sizeof(m_w), m_w);
+    std::copy_n(other.m_wM, sizeof(m_wM), m_wM);
+    std::copy_n(other.m_wN, sizeof(m_wN), m_wN);
+    return true;
+  }
+
+  /** @brief Wipe the verifier. */
+  void clear() noexcept {
+    m_flags = 0;
+    mbedtls_platform_zeroize(m_w, sizeof(m_w));
+    mbedtls_platform_zeroize(m_wM, sizeof(m_wM));
+    mbedtls_platform_zeroize(m_wN, sizeof(m_wN));
+  }
+
+  /** @brief Return whether the verifier holds a value. */
+  bool isValid() const noexcept {
+    return (m_flags & Present) != 0;
+  }
+
+  /** @brief Return whether the precomputed point @p point (WithM or WithN) is included. */
+  bool has(uint8_t point) const noexcept {
+    return (m_flags & point & (WithM | WithN)) != 0;
+  }
+
+  /** @brief Return w, ScalarSize octets in big endian. */
+  const uint8_t* getW() const noexcept {
+    return m_w;
+  }
+
+  /**
+   * @brief Return the precomputed point @p point (WithM or WithN), PointSize octets.
+   * @pre has(point)
+   */
+  const uint8_t* getPoint(uint8_t point) const noexcept {
+    return point == WithM ? m_wM : m_wN;
+  }
+
+private:
+  enum : uint8_t {
+    Present = 0x80, // internal flag, not encoded
+  };
+
+  /** @brief Compute and encode w * @p base . */
+  bool mulBase(uint8_t* out, const mbedtls_mpi* w, typename Ops::Base base,
+               Random& random) noexcept;
+
+private:
+  uint8_t m_flags = 0;
+  uint8_t m_w[ScalarSize]{};
+  uint8_t m_wM[PointSize]{};
+  uint8_t m_wN[PointSize]{};
+};
+
+template<typename Group, typename Hash>
+bool
+Verifier<Group, Hash>::compute(const uint8_t* pw, size_t pwLen, uint8_t points,
+                               Random& random) noexcept {
+  clear();
+  if ((points & ~(WithM | WithN)) != 0) {
+    return false;
+  }
+
+  // w = H(pw) mod p, as in Context::start()
+  std::array<uint8_t, Hash::OutputSize> pwHash{};
+  int ret = mbedtls_md(mbedtls_md_info_from_type(Hash::Type), pw, pwLen, pwHash.data());
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  ndnph::mbedtls::Mpi pwHashScalar;
+  ndnph::mbedtls::Mpi w;
+  ret = mbedtls_mpi_read_binary(pwHashScalar, pwHash.data(), pwHash.size());
+  mbedtls_platform_zeroize(pwHash.data(), pwHash.size());
+  if (ret == 0) {
+    ret = mbedtls_mpi_mod_mpi(w, pwHashScalar, Ops::order());
+  }
+  if (ret == 0) {
+    ret = mbedtls_mpi_write_binary(w, m_w, sizeof(m_w));
+  }
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+
+  using Base = typename Ops::Base;
+  if (((points & WithM) != 0 && !mulBase(m_wM, w, Base::M, random)) ||
+      ((points & WithN) != 0 && !mulBase(m_wN, w, Base::N, random))) {
+    clear();
+    return false;
+  }
+
+  m_flags = static_cast<uint8_t>(Present | points);
+  return true;
+}
+
+template<typename Group, typename Hash>
+bool
+Verifier<Group, Hash>::mulBase(uint8_t* out, const mbedtls_mpi* w, typename Ops::Base base,
+                               Random& random) noexcept {
+  typename Ops::Point P;
+  int ret = Ops::mulBase(P, w, Random::rng, &random, base);
+  if (ret == 0) {
+    ret = Ops::encodePoint(out, PointSize, P);
+  }
+  Ops::clearPoint(P);
+  if (ret != 0) {
+    SPAKE2_MBED_ERR(ret);
+    return false;
+  }
+  return true;
+}
+
+template<typename Group, typename Hash>
+size_t
+Verifier<Group, Hash>::encode(uint8_t* out, size_t outLen) const noexcept {
+  size_t size = getEncodedSize();
+  if (!isValid() || outLen < size) {
+    return 0;
+  }
+
+  *out++ = static_cast<uint8_t>(m_flags & (WithM | WithN));
+  out = std::copy_n(m_w, sizeof(m_w), out);
+  if (has(WithM)) {
+    out = std::copy_n(m_wM, sizeof(m_wM), out);
+  }
+  if (has(WithN)) {
+    std::copy_n(m_wN, sizeof(m_wN), out);
+  }
+  return size;
+}
+
+template<typename Group, typename Hash>
+bool
+Verifier<Group, Hash>::decode(const uint8_t* in, size_t inLen) noexcept {
+  clear();
+  if (inLen < 1 + ScalarSize || (in[0] & ~(WithM | WithN)) != 0) {
+    return false;
+  }
+  m_flags = in[0];
+  if (inLen != getEncodedSize()) {
+    m_flags = 0;
+    return false;
+  }
+  ++in;
+
+  // w must be reduced modulo p
+  ndnph::mbedtls::Mpi w;
+  int ret = mbedtls_mpi_read_binary(w, in, ScalarSize);
+  if (ret != 0 || mbedtls_mpi_cmp_mpi(w, Ops::order()) >= 0) {
+    m_flags = 0;
+    return false;
+  }
+
+  std::copy_n(in, ScalarSize, m_w);
+  in += ScalarSize;
+  if (has(WithM)) {
+    std::copy_n(in, PointSize, m_wM);
+    in += PointSize;
+  }
+  if (has(WithN)) {
+    std::copy_n(in, PointSize, m_wN);
+  }
+  m_flags |= Present;
+  return true;
+}
+
+} // namespace spake2
+
+#endif // PION_SPAKE2_VERIFIER_HPP
@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: NIST-PD
+
+#ifndef PION_SPAKE2_WEIERSTRASS_HPP
+#define PION_SPAKE2_WEIERSTRASS_HPP
+
+#include "fixed-base.hpp"
+#include "stats.hpp"
+
+namespace spake2 {
+namespace detail {
+
+class WeierstrassOpsBase {
+protected:
+  static const ndnph::mbedtls::Mpi s_one;
+
+  /**
+   * @brief Read a point in uncompressed or compressed SEC1 format.
+   *
+   * mbedtls_ecp_point_read_binary() does not accept compressed points on Weierstrass curves.
+   * @pre p = 3 mod 4, as on NIST curves.
+   */
+  static int readPoint(const mbedtls_ecp_group* grp, mbedtls_ecp_point* P, const uint8_t* buf,
+                       size_t len) noexcept;
+};
+
+/**
+ * @brief Group operations of Context on a NIST curve, using mbedtls arithmetic.
+ * @tparam Group SPAKE2 group, such as P256.
+ *
+ * A computation is started with beginShare() or beginKey(), continued with run() until done,
+ * and its result is encoded with writeResult(). The results of several computations can be
+ * normalized together with normalize() before they are encoded.
+ */
+template<typename Group>
+class WeierstrassOps : WeierstrassOpsBase {
+public:
+  using FixedBase = detail::FixedBase<Group>;
+  using Base = typename FixedBase::Base;
+
+  /** @brief Public share kept in an EphemeralPool. */
+  using Point = ndnph::mbedtls::EcPoint;
+
+  enum {
+    PointSize = Group::UncompressedPointSize,
+    CompressedPointSize = Group::CompressedPointSize,
+  };
+
+  /** @brief Return the group order. */
+  static const mbedtls_mpi* order() noexcept {
+    return &FixedBase::get().group()->N;
+  }
+
+  /** @brief Compute X = x * base. */
+  static int mulBase(Point& X, const mbedtls_mpi* x, int (*f_rng)(void*, unsigned char*, size_t),
+                     void* p_rng, Base base = Base::G) noexcept {
+    return FixedBase::get().mul(base, X, x, f_rng, p_rng);
+  }
+
+  /**
+   * @brief Decode and validate a point.
+   * @param buf uncompressed or compressed encoding.
+   * @return 0, or an error code if the point is invalid.
+   */
+  static int decodePoint(Point& P, const uint8_t* buf, size_t len) noexcept {
+    mbedtls_ecp_group* grp = FixedBase::get().group();
+    int ret = readPoint(grp, P, buf, len);
+    if (ret != 0) {
+      return ret;
+    }
+    return mbedtls_ecp_check_pubkey(grp, P);
+  }
+
+  /**
+   * @brief Encode a point in uncompressed format.
+   * @param len PointSize.
+   * @return 0, or an error code if the point is the point at infinity.
+   */
+  static int encodePoint(uint8_t* out, size_t len, const Point& P) noexcept {
+    const mbedtls_ecp_point* Q = P;
+    // mbedtls_ecp_is_zero() does not modify the point, but its parameter is not const
+    if (mbedtls_ecp_is_zero(const_cast<mbedtls_ecp_point*>(Q))) {
+      return MBEDTLS_ERR_ECP_INVALID_KEY;
+    }
+    size_t olen = 0;
+    int ret = mbedtls_ecp_point_write_binary(FixedBase::get().group(), Q,
+                                             MBEDTLS_ECP_PF_UNCOMPRESSED, &olen, out, len);
+    if (ret == 0 && olen != len) {
+      return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+    return ret;
+  }
+
+  /** @brief Move @p src into @p dst, and wipe the previous value of @p dst . */
+  static void movePoint(Point& dst, Point& src) noexcept {
+    mbedtls_ecp_point* d = dst;
+    mbedtls_ecp_point* s = src;
+    mbedtls_mpi_swap(&d->X, &s->X);
+    mbedtls_mpi_swap(&d->Y, &s->Y);
+    mbedtls_mpi_swap(&d->Z, &s->Z);
+    mbedtls_ecp_point_free(s);
+  }
+
+  /** @brief Wipe a point. */
+  static void clearPoint(Point& P) noexcept {
+    mbedtls_ecp_point_free(P);
+  }
+
+  /**
+   * @brief Start computing x * G + w * base, where either term may be precomputed.
+   * @param X precomputed x * G, or nullptr.
+   * @param wB precomputed w * base, or nullptr.
+   * @note Scalars and precomputed points must outlive the computation.
+   */
+  int beginShare(const mbedtls_mpi* x, Point* X, Base base, const mbedtls_mpi* w, Point* wB,
+                 int (*f_rng)(void*, unsigned char*, size_t), void* p_rng) noexcept {
+    if (X == nullptr && wB == nullptr) {
+      return m_jointMul.begin(m_group, m_base.table(Base::G), x, m_base.table(base), w, f_rng,
+                              p_rng);
+    }
+    if (X == nullptr) {
+      m_addend = *wB;
+      m_addBase = Base::G;
+      m_w = x;
+    } else {
+      m_addend = *X;
+      m_addBase = base;
+      m_w = w;
+      if (wB != nullptr) {
+        m_product = *wB;
+      }
+    }
+    m_rng = f_rng;
+    m_pRng = p_rng;
+    return 0;
+  }
+
+  /**
+   * @brief Start computing h * (x * P + s * base), where P is the peer's public share.
+   * @param peer encoded P, uncompressed or compressed.
+   * @param[out] canonical uncompressed encoding of P, PointSize octets.
+   * @return 0, or an error code if P is invalid.
+   * @note The cofactor h is 1 for NIST curves.
+   */
+  int beginKey(const uint8_t* peer, size_t peerLen, uint8_t* canonical, const mbedtls_mpi* x,
+               Base base, const mbedtls_mpi* s, int (*f_rng)(void*, unsigned char*, size_t),
+               void* p_rng) noexcept {
+    ndnph::mbedtls::EcPoint P;
+    {
+      SPAKE2_STATS_SCOPE(PointValidate);
+      int ret = readPoint(m_group, P, peer, peerLen);
+      if (ret != 0) {
+        return ret;
+      }
+      // Verify that the received point is on the curve
+      ret = mbedtls_ecp_check_pubkey(m_group, P);
+      if (ret != 0) {
+        return ret;
+      }
+      size_t len = 0;
+      ret = mbedtls_ecp_point_write_binary(m_group, P, MBEDTLS_ECP_PF_UNCOMPRESSED, &len,
+                                           canonical, PointSize);
+      if (ret != 0) {
+        return ret;
+      }
+    }
+
+    // the comb table of P is filled by run(), within its budget
+    SPAKE2_STATS_SCOPE(ScalarMul);
+    int ret = m_jointMul.beginTable(m_group, m_peerTable, P);
+    if (ret != 0) {
+      return ret;
+    }
+    return m_jointMul.begin(m_group, m_peerTable, x, m_base.table(base), s, f_rng, p_rng);
+  }
+
+  /**
+   * @brief Continue the computation.
+   * @param maxOps budget in the units of mbedtls_ecp_set_max_ops(); 0 means unlimited.
+   * @return 0 if done, MBEDTLS_ERR_ECP_IN_PROGRESS if it must be resumed, or an error code.
+   */
+  int run(unsigned maxOps) noexcept {
+    if (m_addend == nullptr) {
+      int ret = m_jointMul.run(m_R, maxOps);
+      if (ret != MBEDTLS_ERR_ECP_IN_PROGRESS) {
+        m_peerTable.clear();
+      }
+      return ret;
+    }
+
+    ndnph::mbedtls::EcPoint T;
+    const mbedtls_ecp_point* product = m_product;
+    int ret = 0;
+    if (product == nullptr) {
+      mbedtls_ecp_group* grp = m_base.group(m_addBase);
+      ret = mulStep(grp, T, m_w, &grp->G, maxOps);
+      product = T;
+    }
+    if (ret == 0) {
+      // NOTE: mbedtls_ecp_muladd() is _not_ constant time, but both scalars are 1 here
+      ret = mbedtls_ecp_muladd(m_group, m_R, s_one, product, s_one, m_addend);
+    }
+    if (ret != MBEDTLS_ERR_ECP_IN_PROGRESS) {
+      m_addend = nullptr;
+      m_product = nullptr;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Convert the results of several completed computations to affine coordinates, sharing
+   *        one field inversion.
+   *
+   * This is optional: writeResult() normalizes a result that has not been normalized.
+   */
+  static int normalize(WeierstrassOps* const* ops, size_t n) noexcept {
+    mbedtls_ecp_point* pts[JointMul::NormalizeChunk];
+    int ret = 0;
+    while (n > 0 && ret == 0) {
+      size_t m = std::min<size_t>(n, JointMul::NormalizeChunk);
+      for (size_t i = 0; i < m; ++i) {
+        pts[i] = ops[i]->m_R;
+      }
+      ret = ops[0]->m_jointMul.normalize(ops[0]->m_group, pts, m);
+      ops += m;
+      n -= m;
+    }
+    return ret;
+  }
+
+  /**
+   * @brief Encode the result.
+   * @param len PointSize for the uncompressed format, or CompressedPointSize for the compressed
+   *            format.
+   * @return 0, or an error code if the result is the point at infinity.
+   */
+  int writeResult(uint8_t* out, size_t len) noexcept {
+    if (mbedtls_ecp_is_zero(m_R)) {
+      return MBEDTLS_ERR_ECP_INVALID_KEY;
+    }
+    mbedtls_ecp_point* R = m_R;
+    int ret = m_jointMul.normalize(m_group, &R, 1);
+    if (ret != 0) {
+      return ret;
+    }
+    int format = len == CompressedPointSize ? MBEDTLS_ECP_PF_COMPRESSED
+                                            : MBEDTLS_ECP_PF_UNCOMPRESSED;
+    size_t olen = 0;
+    ret = mbedtls_ecp_point_write_binary(m_group, m_R, format, &olen, out, len);
+    if (ret == 0 && olen != len) {
+      return MBEDTLS_ERR_ECP_BAD_INPUT_DATA;
+    }
+    return ret;
+  }
+
+  /** @brief Abandon the computation and wipe intermediate values and the result. */
+  void clear() noexcept {
+    m_jointMul.clear();
+    m_peerTable.clear();
+    mbedtls_ecp_point_free(m_R);
+    m_addend = nullptr;
+    m_product = nullptr;
+#ifdef MBEDTLS_ECP_RESTARTABLE
+    mbedtls_ecp_restart_free(m_rs);
+    mbedtls_ecp_restart_init(m_rs);
+#endif
+  }
+
+private:
+  /**
+   * @brief Compute R = m * P within @p maxOps .
+   * @return 0 if done, MBEDTLS_ERR_ECP_IN_PROGRESS if it must be resumed, or an error code.
+   * @note R is only written when the multiplication is done.
+   */
+  int mulStep(mbedtls_ecp_group* grp, mbedtls_ecp_point* R, const mbedtls_mpi* m,
+              const mbedtls_ecp_point* P, unsigned maxOps) noexcept {
+#ifdef MBEDTLS_ECP_RESTARTABLE
+    if (maxOps > 0) {
+      // the budget is a global setting in mbedtls, so it is set before every call
+      mbedtls_ecp_set_max_ops(maxOps);
+      return mbedtls_ecp_mul_restartable(grp, R, m, P, m_rng, m_pRng, m_rs);
+    }
+#else
+    (void)maxOps;
+#endif
+    return mbedtls_ecp_mul(grp, R, m, P, m_rng, m_pRng);
+  }
+
+private:
+  FixedBase& m_base = FixedBase::get();
+  mbedtls_ecp_group* m_group = m_base.group();
+  JointMul m_jointMul;
+  JointMul::Table m_peerTable; // comb table of the peer's public share
+  ndnph::mbedtls::EcPoint m_R;
+
+  // addend + m_w * m_addBase, or addend + product if the product has been precomputed
+  const mbedtls_ecp_point* m_addend = nullptr;
+  const mbedtls_ecp_point* m_product = nullptr;
+  Base m_addBase = Base::G;
+  const mbedtls_mpi* m_w = nullptr;
+  int (*m_rng)(void*, unsigned char*, size_t) = nullptr;
+  void* m_pRng = nullptr;
+#ifdef MBEDTLS_ECP_RESTARTABLE
+  mbed::Object<mbedtls_ecp_restart_ctx, mbedtls_ecp_restart_init, mbedtls_ecp_restart_free> m_rs;
+#endif
+};
+
+} // namespace detail
+} // namespace spake2
+
+#endif // PION_SPAKE2_WEIERSTRASS_HPP